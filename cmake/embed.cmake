@@ -0,0 +1,16 @@
+# Turns a binary file into a C source defining it as a byte array, so the
+# GUI carries its assets instead of reading them from the working directory.
+#
+#   cmake -DINPUT=file -DOUTPUT=file.c -DSYMBOL=name -P embed.cmake
+#
+# defines `const unsigned char name[]` and `const unsigned int name_size`.
+
+file(READ "${INPUT}" bytes HEX)
+string(LENGTH "${bytes}" length)
+math(EXPR size "${length} / 2")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${bytes}")
+string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n    " bytes "${bytes}")
+file(WRITE "${OUTPUT}"
+     "/* Generated from ${INPUT} by cmake/embed.cmake, do not edit */\n"
+     "const unsigned char ${SYMBOL}[] = {\n    ${bytes}\n};\n"
+     "const unsigned int ${SYMBOL}_size = ${size};\n")
@@ -0,0 +1,33 @@
+#ifndef __BITBASE_H__
+#define __BITBASE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "position.h"
+
+#define BITBASE_DEFAULT_FILE "bitbases.bin"
+#define BITBASE_PATH_ENV "CHESS_BITBASES"       /** overrides the default location */
+#define BITBASE_CACHE_DIR "chess-engine-c"      /** under $XDG_CACHE_HOME or ~/.cache */
+#define BITBASE_PATH_MAX 4096
+
+/* Below the mate scores, above anything the evaluation can reach */
+#define VALUE_KNOWN_WIN 10000
+
+/**
+ * BitbaseResult - a probe's verdict from the side to move's point of
+ * view; UNKNOWN when the material is not covered
+ */
+typedef enum {
+    BITBASE_UNKNOWN, BITBASE_DRAW, BITBASE_WIN, BITBASE_LOSS
+} BitbaseResult;
+
+bool bitbaseDefaultPath(char* path, size_t size);
+bool bitbaseInit(const char* path, int threads);
+bool bitbaseGenerate(const char* path, int threads);
+bool bitbaseLoad(const char* path);
+void bitbaseFree(void);
+
+BitbaseResult bitbaseProbe(const Position* pos);
+int bitbaseScore(const Position* pos, BitbaseResult result);
+
+#endif  /** __BITBASE_H__ */
@@ -0,0 +1,82 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <stdint.h>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+/**
+ * Bitboard - one bit per square, bit n set for square n (a1 = bit 0)
+ */
+typedef uint64_t Bitboard;
+
+#define SQUARE_BB(square) ((Bitboard)1 << (square))
+
+#define ROW_1_BB 0x00000000000000FFULL
+#define ROW_2_BB 0x000000000000FF00ULL
+#define ROW_7_BB 0x00FF000000000000ULL
+#define ROW_8_BB 0xFF00000000000000ULL
+#define COL_A_BB 0x0101010101010101ULL
+#define COL_H_BB 0x8080808080808080ULL
+
+/**
+ * Magic - sliding attack lookup for one square: the relevant occupancy
+ * bits are hashed (magic multiply, or PEXT where available) into an
+ * index into that square's slice of the shared attack table
+ */
+typedef struct {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard* attacks;
+    unsigned shift;
+} Magic;
+
+extern Bitboard KnightAttacks[64];
+extern Bitboard KingAttacks[64];
+extern Bitboard PawnAttacks[3][64];
+extern Magic BishopMagics[64];
+extern Magic RookMagics[64];
+extern Bitboard BetweenBB[64][64];   /** squares strictly between two aligned squares */
+extern Bitboard LineBB[64][64];      /** the whole line through two aligned squares */
+
+void bitboardInit(void);
+
+static inline int popCount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+static inline int lsb(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+
+static inline int popLsb(Bitboard* b) {
+    int square = __builtin_ctzll(*b);
+    *b &= *b - 1;
+    return square;
+}
+
+static inline unsigned magicIndex(const Magic* m, Bitboard occupied) {
+#ifdef USE_PEXT
+    return (unsigned)_pext_u64(occupied, m->mask);
+#else
+    return (unsigned)(((occupied & m->mask) * m->magic) >> m->shift);
+#endif
+}
+
+static inline Bitboard bishopAttacks(int square, Bitboard occupied) {
+    const Magic* m = &BishopMagics[square];
+    return m->attacks[magicIndex(m, occupied)];
+}
+
+static inline Bitboard rookAttacks(int square, Bitboard occupied) {
+    const Magic* m = &RookMagics[square];
+    return m->attacks[magicIndex(m, occupied)];
+}
+
+static inline Bitboard queenAttacks(int square, Bitboard occupied) {
+    return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+}
+
+#endif  /** __BITBOARD_H__ */
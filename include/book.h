@@ -0,0 +1,44 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "position.h"
+
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_MAX_MOVES 64
+
+/* Polyglot's own key for the initial position, from the format spec */
+#define POLYGLOT_START_KEY 0x463B96181691FC9CULL
+
+/**
+ * Book - a Polyglot .bin opening book mapped read-only into memory.
+ * The file is a sorted array of 16-byte big-endian entries (key, move,
+ * weight, learn) and is probed in place, never copied.
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t size;            /** bytes mapped */
+    size_t count;           /** entries */
+} Book;
+
+/**
+ * BookMove - one book reply and its share of the weight
+ */
+typedef struct {
+    Move move;
+    uint16_t weight;
+} BookMove;
+
+bool bookUsesPolyglotKeys(void);
+
+bool bookOpen(Book* book, const char* path);
+void bookClose(Book* book);
+
+uint64_t bookKey(const Position* pos);
+uint16_t bookEncodeMove(Move move);
+int bookProbe(const Book* book, const Position* pos, BookMove* moves, int max);
+Move bookPick(const Book* book, const Position* pos, uint64_t* seed);
+
+#endif  /** __BOOK_H__ */
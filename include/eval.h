@@ -0,0 +1,37 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include "pawns.h"
+#include "position.h"
+
+#define PAWN_VALUE 100
+#define KNIGHT_VALUE 320
+#define BISHOP_VALUE 330
+#define ROOK_VALUE 500
+#define QUEEN_VALUE 900
+
+#define PHASE_MAX 24
+#define TEMPO 15
+
+/**
+ * MAKE_SCORE - packs a midgame and an endgame value into one Score so
+ * both are summed with a single addition; the endgame half lives in the
+ * upper 16 bits and is borrowed from by a negative midgame half
+ */
+#define MAKE_SCORE(mg, eg) ((Score)((int32_t)((uint32_t)(eg) << 16) + (mg)))
+
+static inline int mgValue(Score score) {
+    return (int16_t)(uint16_t)(uint32_t)score;
+}
+
+static inline int egValue(Score score) {
+    return (int16_t)(uint16_t)((uint32_t)(score + 0x8000) >> 16);
+}
+
+extern const int PieceValue[KING + 1];
+extern Score PieceSquare[PIECE_NB][SQUARE_NB];
+
+void evalInit(void);
+int evaluate(const Position* pos, PawnTable* pawns);
+
+#endif  /** __EVAL_H__ */
@@ -4,101 +4,130 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
+#include "bitbase.h"
+#include "book.h"
+#include "pgn.h"
+#include "record.h"
+#include "search.h"
 
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 640
-#define BOARD_SIZE 8
 #define SQUARE_SIZE (WINDOW_WIDTH / BOARD_SIZE)
-#define OCCUPIED true
-#define NOT_OCCUPIED false
+#define ENGINE_MOVE_TIME 1000
+#define ENGINE_STACK_SIZE (8 * 1024 * 1024)    /** the engine thread runs search thread 0 */
 
-typedef enum {
-    EMPTY, PAWN, KNIGHT, BISHOP,
-    ROOK, QUEEN, KING
-} PieceType;
-
-typedef enum {
-    NONE, WHITE, BLACK
-} PieceColor;
-
-typedef struct {
-    PieceType type;
-    PieceColor color;
-    SDL_Texture* texture;
-} Piece;
-
-typedef struct {
-    Piece movedPiece;
-    int fromRow, fromCol;
-    int toRow, toCol;
-    Piece capturedPiece;
-} Move;
+/* Cell size of the sprite atlas, as packed by scripts/pack_atlas.py */
+#define ATLAS_CELL 80
 
-typedef struct {
-    int row;
-    int col;
-    int occupied;
-    SDL_Rect rect;
-    Piece piece;
-} Cell;
+/* assets/pieces.bmp, compiled in by cmake/embed.cmake */
+extern const unsigned char pieceAtlasBmp[];
+extern const unsigned int pieceAtlasBmp_size;
 
 typedef struct {
-    Piece* selectedPiece;
     int selectedRow;
     int selectedCol;
     SDL_bool pieceSelected;
 } PlayerState;
 
+typedef enum {
+    ENGINE_IDLE, ENGINE_THINK, ENGINE_PONDER, ENGINE_QUIT
+} EngineJob;
+
+/**
+ * EngineWorker - the search thread behind the board. The GUI hands it
+ * jobs under lock and never waits for one; a finished search comes back
+ * as an eventType user event carrying the job's generation, so a reply
+ * to a position the board has since left (undo, redo, a pasted game) is
+ * simply dropped. During the human's turn it ponders on the reply it
+ * expects, and if that reply is played the running search becomes the
+ * engine's move.
+ */
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* wake;
+    Uint32 eventType;           /** code = generation, data1 = move, data2 = expected reply */
+    Search* search;
+
+    EngineJob job;
+    int generation;             /** bumped by every new job and every cancel */
+    SDL_bool pending;           /** job not yet taken by the thread */
+    SDL_bool busy;              /** thread is inside searchRun */
+    int searchGeneration;       /** job the running search belongs to */
+    Position start;             /** the job's game: start and moves */
+    Move* moves;
+    int moveCount;
+    int moveCapacity;
+
+    SDL_bool ponder;            /** think on the human's time */
+    uint64_t ponderKey;         /** position after the expected reply */
+    Uint32 ponderStart;
+    SDL_bool ponderDone;        /** ponder search ended before the reply came */
+    Move ponderBest;
+    Move ponderReply;
+    SDL_TimerID stopTimer;      /** ends a ponder search that became the move */
+    int timerGeneration;        /** job the stop timer belongs to */
+} EngineWorker;
+
 typedef struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_bool gameIsActive;
-    Cell board[BOARD_SIZE][BOARD_SIZE];
+    Position position;
     SDL_Event *e;
     PlayerState playerState;
 
-    PieceColor currentTurn;
-
-    SDL_Texture* white_pawn;
-    SDL_Texture* white_knight;
-    SDL_Texture* white_bishop;
-    SDL_Texture* white_rook;
-    SDL_Texture* white_king;
-    SDL_Texture* white_queen;
-    SDL_Texture* black_pawn;
-    SDL_Texture* black_knight;
-    SDL_Texture* black_bishop;
-    SDL_Texture* black_rook;
-    SDL_Texture* black_king;
-    SDL_Texture* black_queen;
-
-    Move undoStack[256];
-    Move redoStack[256];
-    int undoIndex;
-    int redoIndex;
+    SDL_Texture* pieceAtlas;    /** every piece sprite, see atlasRect */
+
+    Search* search;
+    TransTable tt;
+    EngineWorker engine;
+    PieceColor engineColor;
+    Book book;
+    uint64_t bookSeed;
+
+    /* Render cache: highlights are worked out once per move or
+     * selection, and only squares whose look changed are repainted
+     * into boardTexture */
+    SDL_Texture* boardTexture;
+    uint32_t drawn[SQUARE_NB];  /** look of each square in boardTexture */
+    SDL_bool needsPresent;      /** window needs the board copied again */
+    uint64_t highlightKey;      /** position the highlights belong to */
+    int highlightFrom;          /** selected square they belong to, SQUARE_NONE if none */
+    Bitboard moveTargets;
+    int checkSquare;            /** king in check, SQUARE_NONE if none */
+
+    GameRecord record;          /** moves since the start position, undo and redo */
 } GameState;
 
 void initializeBoard(GameState* state);
 void initializePieces(GameState* state);
-void loadPieceTextures(GameState* state);
+SDL_bool loadFen(GameState* state, const char* fen);
+void saveFen(GameState* state);
+SDL_bool loadPgn(GameState* state, FILE* file);
+void savePgn(GameState* state);
 
-SDL_Texture* loadTexture(const char* file, SDL_Renderer* renderer);
+SDL_Texture* loadPieceAtlas(SDL_Renderer* renderer);
 
 void handleEvents(GameState* state);
 void handleMouseClick(GameState* state, int x, int y);
 void movePiece(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
+void undoMove(GameState* state);
+void redoMove(GameState* state);
+
+SDL_bool engineStart(GameState* state);
+void engineQuit(GameState* state);
+void engineMove(GameState* state);
+void engineCancel(GameState* state);
+void handleEngineReply(GameState* state, const SDL_UserEvent* reply);
+void announceGameStatus(GameState* state);
 
 SDL_bool isCheckMate(GameState* state, PieceColor color);
 SDL_bool isKingInCheck(GameState* state, PieceColor color);
 
 SDL_bool validateMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validateKingMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validateQueenMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validateBishopMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validateKnightMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validateRookMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
-SDL_bool validatePawnMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol);
 
+void updateHighlights(GameState* state);
 void drawBoard(GameState* state);
 
 #endif  /** __MAIN_H__ */
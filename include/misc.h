@@ -0,0 +1,9 @@
+#ifndef __MISC_H__
+#define __MISC_H__
+
+#include <stdint.h>
+
+int64_t timeNowMs(void);
+uint64_t randomNext(uint64_t* seed);
+
+#endif  /** __MISC_H__ */
@@ -0,0 +1,27 @@
+#ifndef __MOVEGEN_H__
+#define __MOVEGEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+
+#define MAX_MOVES 256
+
+typedef struct {
+    Move moves[MAX_MOVES];
+    int count;
+} MoveList;
+
+int generateCaptures(const Position* pos, MoveList* list);
+int generateLegalMoves(const Position* pos, MoveList* list);
+
+Move positionFindMove(const Position* pos, int from, int to, PieceType promoted);
+bool positionIsLegalMove(const Position* pos, int from, int to);
+bool positionIsCheckMate(const Position* pos);
+bool positionIsStaleMate(const Position* pos);
+
+char* moveToString(Move move, char* buffer);
+Move moveFromString(const Position* pos, const char* text);
+uint64_t perft(Position* pos, int depth);
+
+#endif  /** __MOVEGEN_H__ */
@@ -0,0 +1,73 @@
+#ifndef __NNUE_H__
+#define __NNUE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "position.h"
+
+/* Network shape: 768 piece-square inputs seen from each side, a
+ * 256-wide accumulator per side, two hidden layers of 32, one output */
+#define NNUE_INPUTS 768
+#define NNUE_HIDDEN 256
+#define NNUE_L2 32
+#define NNUE_L3 32
+
+#define NNUE_RELU_MAX 127       /** 1.0 in the clipped activations */
+#define NNUE_WEIGHT_SHIFT 6     /** hidden-layer weights are scaled by 64 */
+#define NNUE_OUTPUT_SCALE 16    /** output units per centipawn */
+#define NNUE_DIRTY_MAX 3        /** a capture-promotion changes three pieces */
+#define NNUE_EVAL_MAX 10000     /** keeps network scores below the mate range */
+
+typedef enum {
+    NNUE_SCALAR, NNUE_SSE41, NNUE_AVX2, NNUE_SIMD_NB
+} NnueSimd;
+
+/**
+ * NnueAccumulator - the first layer's output for one position, from
+ * white's side ([0]) and black's ([1]). A searching thread keeps a stack
+ * of them, one per ply, and Position.nnue points at the current one.
+ * positionMakeMove only notes which pieces changed; the values are
+ * brought up to date from the nearest computed entry below when the
+ * position is evaluated, so a position that is never evaluated costs
+ * next to nothing. dirtyCount is -1 on the bottom entry, which has no
+ * entry below to update from.
+ */
+typedef struct NnueAccumulator {
+    int16_t values[2][NNUE_HIDDEN];
+    bool computed;
+    int8_t dirtyCount;
+    Piece dirtyPiece[NNUE_DIRTY_MAX];
+    uint8_t dirtyFrom[NNUE_DIRTY_MAX];  /** SQUARE_NONE for a piece put on the board */
+    uint8_t dirtyTo[NNUE_DIRTY_MAX];    /** SQUARE_NONE for a piece taken off */
+} NnueAccumulator;
+
+bool nnueLoad(const char* path);
+bool nnueSave(const char* path);
+bool nnueRandomize(uint64_t seed);
+void nnueFree(void);
+bool nnueLoaded(void);
+
+bool nnueSimdSupported(NnueSimd simd);
+bool nnueSetSimd(NnueSimd simd);
+NnueSimd nnueGetSimd(void);
+const char* nnueSimdName(NnueSimd simd);
+
+int nnueEvaluate(const Position* pos);
+
+/**
+ * nnueReset - makes @root the bottom of an accumulator stack; it is
+ * computed from scratch the first time it is evaluated
+ */
+static inline void nnueReset(NnueAccumulator* root) {
+    root->computed = false;
+    root->dirtyCount = -1;
+}
+
+static inline void nnueMarkDirty(NnueAccumulator* acc, Piece piece, int from, int to) {
+    acc->dirtyPiece[acc->dirtyCount] = piece;
+    acc->dirtyFrom[acc->dirtyCount] = (uint8_t)from;
+    acc->dirtyTo[acc->dirtyCount] = (uint8_t)to;
+    acc->dirtyCount++;
+}
+
+#endif  /** __NNUE_H__ */
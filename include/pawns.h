@@ -0,0 +1,43 @@
+#ifndef __PAWNS_H__
+#define __PAWNS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "position.h"
+
+#define PAWN_HASH_DEFAULT_KB 1024
+
+/**
+ * PawnEntry - the pawn-structure verdict for one pawn skeleton. The
+ * king shelter also depends on where each king stands, so it is cached
+ * together with the king square it was computed for.
+ */
+typedef struct {
+    uint64_t key;
+    Score score;            /** white minus black structure score */
+    uint8_t kingSquare[3];  /** SQUARE_NONE until a shelter is cached */
+    Score shelter[3];
+} PawnEntry;
+
+/**
+ * PawnTable - direct-mapped cache of pawn entries indexed by the pawn
+ * key; one per search thread so it needs no synchronisation
+ */
+typedef struct {
+    PawnEntry* entries;
+    size_t mask;            /** entry count - 1, the count a power of two */
+    uint64_t probes;
+    uint64_t hits;
+} PawnTable;
+
+void pawnsInit(void);
+
+bool pawnTableResize(PawnTable* table, size_t sizeKb);
+void pawnTableFree(PawnTable* table);
+void pawnTableClear(PawnTable* table);
+
+PawnEntry* pawnProbe(PawnTable* table, const Position* pos, PawnEntry* scratch);
+Score pawnShelter(PawnEntry* entry, const Position* pos, PieceColor us);
+
+#endif  /** __PAWNS_H__ */
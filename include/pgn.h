@@ -0,0 +1,73 @@
+#ifndef __PGN_H__
+#define __PGN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "position.h"
+
+#define SAN_MAX 12
+#define PGN_TAGS_MAX 32
+#define PGN_TAG_NAME_MAX 32
+#define PGN_TAG_VALUE_MAX 256
+#define PGN_READ_BUFFER (1 << 20)
+
+typedef struct {
+    char name[PGN_TAG_NAME_MAX];
+    char value[PGN_TAG_VALUE_MAX];
+} PgnTag;
+
+/**
+ * PgnGame - one game: its tags, start position (from the FEN tag, the
+ * standard position otherwise), main line and result. Comments,
+ * variations and annotations are dropped on reading. error is empty
+ * when every move replayed legally; otherwise moves holds the line up
+ * to the first bad move.
+ */
+typedef struct {
+    PgnTag tags[PGN_TAGS_MAX];
+    int tagCount;
+    Position start;
+    Position end;           /** after the last move, filled in by pgnRead */
+    Move* moves;
+    int moveCount;
+    int moveCapacity;
+    char result[8];         /** "1-0", "0-1", "1/2-1/2" or "*" */
+    uint64_t line;          /** input line the game starts on */
+    char error[128];
+} PgnGame;
+
+/**
+ * PgnReader - pulls games one at a time from a stream through a fixed
+ * buffer, so a database of any size is read in constant memory
+ */
+typedef struct {
+    FILE* file;
+    char* buffer;
+    size_t capacity;
+    size_t start;           /** first unread byte */
+    size_t end;             /** end of the buffered bytes */
+    bool eof;
+    bool pending;           /** line already read belongs to the next game */
+    char* line;
+    uint64_t lineNumber;
+    uint64_t bytes;         /** bytes consumed so far */
+} PgnReader;
+
+char* moveToSan(const Position* pos, Move move, char* buffer);
+Move moveFromSan(const Position* pos, const char* san);
+
+void pgnGameInit(PgnGame* game);
+void pgnGameFree(PgnGame* game);
+void pgnGameReset(PgnGame* game, const Position* start);
+bool pgnGameAddMove(PgnGame* game, Move move);
+const char* pgnGetTag(const PgnGame* game, const char* name);
+void pgnSetTag(PgnGame* game, const char* name, const char* value);
+
+bool pgnReaderOpen(PgnReader* reader, FILE* file);
+void pgnReaderClose(PgnReader* reader);
+bool pgnRead(PgnReader* reader, PgnGame* game);
+
+void pgnWrite(FILE* out, const PgnGame* game);
+
+#endif  /** __PGN_H__ */
@@ -0,0 +1,160 @@
+#ifndef __POSITION_H__
+#define __POSITION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bitboard.h"
+
+#define BOARD_SIZE 8
+#define SQUARE_NB 64
+#define SQUARE_NONE 64
+
+#define SQUARE(row, col) ((row) * BOARD_SIZE + (col))
+#define ROW_OF(square) ((square) >> 3)
+#define COL_OF(square) ((square) & 7)
+
+typedef enum {
+    EMPTY, PAWN, KNIGHT, BISHOP,
+    ROOK, QUEEN, KING
+} PieceType;
+
+typedef enum {
+    NONE, WHITE, BLACK
+} PieceColor;
+
+/**
+ * Piece - one byte per square: (color << 3) | type, 0 for an empty square
+ */
+typedef uint8_t Piece;
+
+/**
+ * Score - midgame and endgame value packed together, see MAKE_SCORE
+ */
+typedef int32_t Score;
+
+#define PIECE_NB 24
+#define MAKE_PIECE(color, type) ((Piece)(((color) << 3) | (type)))
+#define PIECE_TYPE(piece) ((PieceType)((piece) & 7))
+#define PIECE_COLOR(piece) ((PieceColor)((piece) >> 3))
+#define OPPONENT(color) ((color) == WHITE ? BLACK : WHITE)
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define FEN_MAX 96
+
+/**
+ * CastlingRight - one bit per king/side pair, combined in a 4-bit mask
+ */
+typedef enum {
+    WHITE_OO = 1, WHITE_OOO = 2,
+    BLACK_OO = 4, BLACK_OOO = 8,
+    ALL_CASTLING = 15
+} CastlingRight;
+
+/**
+ * Move - from square in bits 0-5, to square in bits 6-11, promotion
+ * piece (knight..queen) in bits 12-13 and the move type in bits 14-15.
+ * Castling is encoded as the king's two-square step.
+ */
+typedef uint16_t Move;
+
+#define MOVE_NONE 0
+#define MOVE_NORMAL 0
+#define MOVE_PROMOTION (1 << 14)
+#define MOVE_EN_PASSANT (2 << 14)
+#define MOVE_CASTLING (3 << 14)
+
+#define MAKE_MOVE(from, to) ((Move)((from) | ((to) << 6)))
+#define MAKE_SPECIAL(from, to, type) ((Move)((from) | ((to) << 6) | (type)))
+#define MAKE_PROMOTION(from, to, promoted) ((Move)((from) | ((to) << 6) | MOVE_PROMOTION | (((promoted) - KNIGHT) << 12)))
+#define MOVE_FROM(move) ((move) & 63)
+#define MOVE_TO(move) (((move) >> 6) & 63)
+#define MOVE_TYPE(move) ((move) & (3 << 14))
+#define MOVE_PROMOTED(move) ((PieceType)((((move) >> 12) & 3) + KNIGHT))
+
+/**
+ * Position - compact, renderer independent game position
+ *
+ * Row 0 is white's back rank and col 0 the a-file, so a square index
+ * is row * 8 + col (a1 = 0, h8 = 63). The mailbox answers "what is on
+ * this square", the bitboards "where are these pieces". key is the
+ * Zobrist hash of the position and psq its material and piece-square
+ * score, both kept up to date by every edit.
+ *
+ * epSquare is only set when a pawn of the side to move could actually
+ * capture there, so positions that differ in nothing else hash alike.
+ * history is the undo record of the move that led here, the head of
+ * the key chain used for repetition detection. nnue is this ply's
+ * entry on a searching thread's accumulator stack (see nnue.h), NULL
+ * when the position is not evaluated by the network.
+ */
+typedef struct {
+    Piece board[SQUARE_NB];
+    Bitboard byType[KING + 1];
+    Bitboard byColor[3];
+    uint64_t key;
+    uint64_t pawnKey;           /** Zobrist hash of the pawns alone */
+    uint8_t pieceCount[PIECE_NB];
+    Score psq;                  /** material + piece-square, white's view */
+    uint8_t kingSquare[3];
+    PieceColor sideToMove;
+    uint8_t castlingRights;
+    uint8_t epSquare;           /** SQUARE_NONE if none */
+    uint16_t rule50;            /** halfmoves since the last capture or pawn move */
+    uint16_t fullmoveNumber;
+    const struct UndoInfo* history;
+    struct NnueAccumulator* nnue;
+} Position;
+
+/**
+ * UndoInfo - what positionMakeMove cannot recompute on the way back;
+ * lives on the caller's stack so make/unmake never allocates. The
+ * records of the moves played so far link into a chain of earlier keys,
+ * so they must stay in place while the position is in use.
+ */
+typedef struct UndoInfo {
+    const struct UndoInfo* previous;
+    uint64_t key;
+    uint64_t pawnKey;
+    Piece captured;
+    uint8_t castlingRights;
+    uint8_t epSquare;
+    uint16_t rule50;
+} UndoInfo;
+
+extern uint64_t ZobristPiece[PIECE_NB][SQUARE_NB];
+extern uint64_t ZobristSide;
+extern uint64_t ZobristCastling[ALL_CASTLING + 1];
+extern uint64_t ZobristEnPassant[BOARD_SIZE];
+
+static inline Bitboard positionOccupied(const Position* pos) {
+    return pos->byColor[WHITE] | pos->byColor[BLACK];
+}
+
+static inline Bitboard positionPieces(const Position* pos, PieceColor color, PieceType type) {
+    return pos->byColor[color] & pos->byType[type];
+}
+
+static inline bool positionIsCapture(const Position* pos, Move move) {
+    return pos->board[MOVE_TO(move)] != EMPTY || MOVE_TYPE(move) == MOVE_EN_PASSANT;
+}
+
+void chessCoreInit(void);
+
+void positionClear(Position* pos);
+void positionSetStart(Position* pos);
+bool positionSetFen(Position* pos, const char* fen);
+const char* positionSetEpd(Position* pos, const char* epd);
+char* positionToFen(const Position* pos, char* buffer);
+char* positionToEpd(const Position* pos, char* buffer);
+void positionPutPiece(Position* pos, int square, Piece piece);
+void positionRemovePiece(Position* pos, int square);
+
+Bitboard positionAttackersTo(const Position* pos, int square, Bitboard occupied);
+bool positionIsSquareAttacked(const Position* pos, int square, PieceColor by);
+bool positionInCheck(const Position* pos, PieceColor color);
+void positionMakeMove(Position* pos, Move move, UndoInfo* undo);
+void positionUnmakeMove(Position* pos, Move move, const UndoInfo* undo);
+bool positionIsDraw(const Position* pos, int ply);
+uint64_t positionComputeKey(const Position* pos);
+
+#endif  /** __POSITION_H__ */
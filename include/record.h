@@ -0,0 +1,49 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <stdbool.h>
+#include "position.h"
+
+#define RECORD_BLOCK_MOVES 256
+
+/**
+ * RecordEntry - a played move and the undo record that takes it back
+ */
+typedef struct {
+    Move move;
+    UndoInfo undo;
+} RecordEntry;
+
+/**
+ * GameRecord - the moves of one game from its start position, with no
+ * length limit. Entries live in fixed blocks that are never moved, so
+ * the undo records can stay linked into the position's key chain while
+ * the record grows. Moves taken back with recordUndo are kept after ply
+ * until recordRedo replays them or a different move replaces them.
+ * Blocks are kept across recordReset and freed only by recordFree.
+ */
+typedef struct {
+    Position start;
+    RecordEntry** blocks;
+    int blockCount;
+    int ply;                /** moves currently on the board */
+    int length;             /** moves recorded, ply plus the redo tail */
+} GameRecord;
+
+void recordInit(GameRecord* record, const Position* start);
+void recordReset(GameRecord* record, const Position* start);
+void recordFree(GameRecord* record);
+
+bool recordPlay(GameRecord* record, Position* pos, Move move);
+bool recordUndo(GameRecord* record, Position* pos);
+bool recordRedo(GameRecord* record, Position* pos);
+
+/**
+ * recordMove - the @ply-th move of the game, counting from 0; @ply must
+ * be below record->length
+ */
+static inline Move recordMove(const GameRecord* record, int ply) {
+    return record->blocks[ply / RECORD_BLOCK_MOVES][ply % RECORD_BLOCK_MOVES].move;
+}
+
+#endif  /** __RECORD_H__ */
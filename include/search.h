@@ -0,0 +1,109 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "movegen.h"
+#include "nnue.h"
+#include "pawns.h"
+#include "tt.h"
+
+#define MAX_PLY 128
+
+#define VALUE_INFINITE 32001
+#define VALUE_MATE 32000
+#define VALUE_MATE_IN_MAX_PLY (VALUE_MATE - MAX_PLY)
+#define VALUE_NONE 32002
+
+#define MAX_THREADS 256
+
+/**
+ * SearchLimits - when to stop; zero fields are "no limit". With none of
+ * depth, nodes, moveTime or a clock set the search runs until stopped.
+ */
+typedef struct {
+    int depth;
+    uint64_t nodes;
+    int64_t moveTime;       /** fixed ms for this move */
+    int64_t time[3];        /** remaining clock per color, ms */
+    int64_t increment[3];   /** increment per color, ms */
+    int movesToGo;
+    bool infinite;
+} SearchLimits;
+
+/**
+ * SearchInfo - result of the deepest completed iteration
+ */
+typedef struct {
+    int depth;
+    int score;
+    uint64_t nodes;         /** all threads */
+    uint64_t nps;
+    int64_t elapsedMs;
+    int hashfull;
+    Move pv[MAX_PLY];
+    int pvLength;
+} SearchInfo;
+
+typedef void (*SearchCallback)(const SearchInfo* info, void* userData);
+
+struct Search;
+
+/**
+ * SearchThread - one Lazy SMP worker: a private copy of the position,
+ * private ordering tables, pawn cache and network accumulators; only
+ * the transposition table is shared
+ */
+typedef struct {
+    struct Search* search;
+    int id;
+    pthread_t handle;
+    bool running;
+
+    Position pos;
+    uint64_t nodes;
+    int completedDepth;
+    SearchInfo info;
+    PawnTable pawns;        /** hit counters restart with every search */
+
+    Move killers[MAX_PLY][2];
+    int history[PIECE_NB][SQUARE_NB];
+    Move pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    NnueAccumulator accumulators[MAX_PLY];  /** one per ply, used while a network is loaded */
+} SearchThread;
+
+/**
+ * Search - one search and its worker threads. Thread 0 runs in the
+ * caller of searchRun and owns time control and reporting; the helpers
+ * search the same root and feed it through the shared table.
+ */
+typedef struct Search {
+    SearchLimits limits;
+    TransTable* tt;         /** shared, may be NULL */
+    bool stop;              /** set by searchStop, cleared as searchRun starts */
+    bool rootInBitbase;     /** bitbase wins are searched out, not cut */
+
+    int64_t startTime;
+    int64_t softLimit;      /** don't start another iteration after this */
+    int64_t hardLimit;      /** abort the running iteration after this */
+
+    int threadCount;
+    SearchThread* threads;
+    size_t pawnHashKb;      /** per thread */
+
+    SearchCallback onIteration;
+    void* userData;
+} Search;
+
+bool searchInit(Search* search, int threadCount);
+bool searchSetThreads(Search* search, int threadCount);
+bool searchSetPawnHash(Search* search, size_t sizeKb);
+void searchFree(Search* search);
+
+Move searchRun(Search* search, const Position* pos, const SearchLimits* limits, SearchInfo* result);
+void searchStop(Search* search);
+uint64_t searchNodes(const Search* search);
+
+#endif  /** __SEARCH_H__ */
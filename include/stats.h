@@ -0,0 +1,89 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Engine instrumentation. Built with USE_STATS (CMake option
+ * CHESS_STATS) the search, move generator and evaluation count into a
+ * block private to each thread, merged only when statsCollect asks for
+ * a total. Without it every STATS_* macro expands to nothing, so the
+ * call sites can stay in production builds at no cost.
+ */
+
+#define STATS_CUTOFF_SLOTS 8    /* the last slot counts every later move */
+
+/**
+ * StatId - the counters; *_NS ones accumulate nanoseconds
+ */
+typedef enum {
+    STAT_NODES,             /** alpha-beta nodes */
+    STAT_QNODES,            /** quiescence nodes */
+    STAT_TT_PROBES,
+    STAT_TT_HITS,
+    STAT_TT_CUTOFFS,        /** nodes answered by the table alone */
+    STAT_BETA_CUTOFFS,
+    STAT_MOVEGEN_CALLS,
+    STAT_MOVEGEN_NS,
+    STAT_EVAL_CALLS,
+    STAT_EVAL_NS,
+    STAT_CHECK_TESTS,       /** positionInCheck, behind isKingInCheck */
+    STAT_LEGALITY_TESTS,    /** positionIsLegalMove, behind validateMove */
+    STAT_NB
+} StatId;
+
+/**
+ * Stats - one thread's counters, or a merged total. cutoffAt[i] counts
+ * beta cutoffs by the i-th move searched at the node.
+ */
+typedef struct {
+    uint64_t counters[STAT_NB];
+    uint64_t cutoffAt[STATS_CUTOFF_SLOTS];
+} Stats;
+
+#ifdef USE_STATS
+
+#define STATS_ENABLED 1
+
+extern __thread Stats ThreadStats;
+
+uint64_t statsClock(void);
+
+/* Only the owning thread writes its block; the relaxed store keeps the
+ * concurrent reads in statsCollect well defined */
+#define STATS_ADD(id, amount) \
+    __atomic_store_n(&ThreadStats.counters[id], ThreadStats.counters[id] + (amount), __ATOMIC_RELAXED)
+#define STATS_INC(id) STATS_ADD(id, 1)
+#define STATS_CUTOFF(index) do { \
+        int slot_ = (index) < STATS_CUTOFF_SLOTS ? (index) : STATS_CUTOFF_SLOTS - 1; \
+        STATS_INC(STAT_BETA_CUTOFFS); \
+        __atomic_store_n(&ThreadStats.cutoffAt[slot_], ThreadStats.cutoffAt[slot_] + 1, __ATOMIC_RELAXED); \
+    } while (0)
+#define STATS_TIMER(name) uint64_t name = statsClock()
+#define STATS_TIME(id, name) STATS_ADD(id, statsClock() - (name))
+
+void statsAttach(void);
+
+#else
+
+#define STATS_ENABLED 0
+
+#define STATS_ADD(id, amount) ((void)0)
+#define STATS_INC(id) ((void)0)
+#define STATS_CUTOFF(index) ((void)0)
+#define STATS_TIMER(name) ((void)0)
+#define STATS_TIME(id, name) ((void)0)
+
+static inline void statsAttach(void) {
+}
+
+#endif
+
+void statsCollect(Stats* total);
+void statsReset(void);
+
+const char* statsName(StatId id);
+int statsFormatJson(const Stats* stats, char* buffer, size_t size);
+
+#endif  /** __STATS_H__ */
@@ -0,0 +1,62 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "position.h"
+
+#define TT_DEFAULT_MB 16
+#define TT_BUCKET_SIZE 4
+
+typedef enum {
+    BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+} Bound;
+
+/**
+ * TTEntry - 16 bytes: the packed data word and the key XORed with it.
+ * A reader accepts the entry only if the two words XOR back to its key,
+ * so a torn write from another thread just reads as a miss and no lock
+ * is needed.
+ */
+typedef struct {
+    uint64_t keyXorData;
+    uint64_t data;
+} TTEntry;
+
+/**
+ * TTBucket - the entries one key may live in; one 64-byte cache line
+ */
+typedef struct {
+    TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+typedef struct {
+    Move move;
+    int16_t score;
+    int16_t eval;
+    uint8_t depth;
+    Bound bound;
+} TTData;
+
+typedef struct {
+    TTBucket* buckets;
+    uint64_t bucketCount;
+    size_t sizeMb;
+    uint8_t generation;     /** stamped on stores, bumped by ttNewSearch */
+} TransTable;
+
+bool ttResize(TransTable* tt, size_t sizeMb);
+void ttFree(TransTable* tt);
+void ttClear(TransTable* tt);
+void ttNewSearch(TransTable* tt);
+
+bool ttProbe(const TransTable* tt, uint64_t key, TTData* data);
+void ttStore(TransTable* tt, uint64_t key, Move move, int score, int eval, int depth, Bound bound);
+int ttHashfull(const TransTable* tt);
+
+static inline void ttPrefetch(const TransTable* tt, uint64_t key) {
+    __builtin_prefetch(&tt->buckets[(uint64_t)(((unsigned __int128)key * tt->bucketCount) >> 64)]);
+}
+
+#endif  /** __TT_H__ */
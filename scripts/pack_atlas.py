@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Packs the twelve piece PNGs in assets/ into one sprite atlas.
+
+The atlas is a 32-bit BMP with an alpha channel, two rows of six cells
+(white, then black; pawn, knight, bishop, rook, queen, king) of CELL
+pixels each, which is the layout src/main.c expects. Each sprite is
+scaled to fit its cell with a box filter and centred. Only the standard
+library is needed, so the PNG decoder below handles just what the
+assets use: 8-bit, non-interlaced greyscale, RGB, palette and RGBA.
+
+usage: pack_atlas.py ASSETS_DIR OUTPUT.bmp
+"""
+
+import struct
+import sys
+import zlib
+
+CELL = 80
+NAMES = ["pawn", "knight", "bishop", "rook", "queen", "king"]
+COLORS = ["white", "black"]
+CHANNELS = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}
+
+
+def read_png(path):
+    data = open(path, "rb").read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        sys.exit("%s: not a PNG" % path)
+    pos, idat, palette, alpha = 8, b"", None, None
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+            if depth != 8 or interlace or color not in CHANNELS:
+                sys.exit("%s: unsupported PNG layout" % path)
+        elif kind == b"PLTE":
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif kind == b"tRNS":
+            alpha = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+    raw = zlib.decompress(idat)
+    bpp = CHANNELS[color]
+    stride = width * bpp
+    rows, previous = [], bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind, line = raw[start], bytearray(raw[start + 1:start + 1 + stride])
+        if kind == 1:
+            for i in range(bpp, stride):
+                line[i] = (line[i] + line[i - bpp]) & 0xFF
+        elif kind == 2:
+            for i in range(stride):
+                line[i] = (line[i] + previous[i]) & 0xFF
+        elif kind == 3:
+            for i in range(stride):
+                left = line[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + ((left + previous[i]) >> 1)) & 0xFF
+        elif kind == 4:
+            for i in range(stride):
+                a = line[i - bpp] if i >= bpp else 0
+                b = previous[i]
+                c = previous[i - bpp] if i >= bpp else 0
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                predictor = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[i] = (line[i] + predictor) & 0xFF
+        rows.append(line)
+        previous = line
+
+    def rgba(line, x):
+        if color == 6:
+            return tuple(line[4 * x:4 * x + 4])
+        if color == 2:
+            return tuple(line[3 * x:3 * x + 3]) + (255,)
+        if color == 4:
+            return (line[2 * x],) * 3 + (line[2 * x + 1],)
+        if color == 3:
+            index = line[x]
+            opacity = alpha[index] if alpha and index < len(alpha) else 255
+            return palette[index] + (opacity,)
+        return (line[x],) * 3 + (255,)
+
+    return width, height, [[rgba(line, x) for x in range(width)] for line in rows]
+
+
+def fit(width, height, pixels):
+    """Box-filters the sprite down into a CELL x CELL RGBA cell."""
+    scale = CELL / max(width, height)
+    outWidth, outHeight = max(1, round(width * scale)), max(1, round(height * scale))
+    left, top = (CELL - outWidth) // 2, (CELL - outHeight) // 2
+    sums = [[0.0] * 5 for _ in range(CELL * CELL)]
+    for y in range(height):
+        row = min(outHeight - 1, int(y * scale)) + top
+        for x, (r, g, b, a) in enumerate(pixels[y]):
+            cell = sums[row * CELL + min(outWidth - 1, int(x * scale)) + left]
+            # Average in premultiplied alpha so transparent pixels do not
+            # bleed their colour into the sprite's edges
+            cell[0] += r * a
+            cell[1] += g * a
+            cell[2] += b * a
+            cell[3] += a
+            cell[4] += 1
+    out = []
+    for r, g, b, a, n in sums:
+        if a == 0:
+            out.append((0, 0, 0, 0))
+        else:
+            out.append((round(r / a), round(g / a), round(b / a), round(a / n)))
+    return out
+
+
+def write_bmp(path, width, height, pixels):
+    """A bottom-up BITMAPV4 with BI_BITFIELDS masks, which SDL_LoadBMP
+    reads with its alpha channel intact."""
+    image = bytearray()
+    for y in reversed(range(height)):
+        for r, g, b, a in pixels[y * width:(y + 1) * width]:
+            image += bytes((b, g, r, a))
+    header = struct.pack("<IiiHHIIiiII", 108, width, height, 1, 32, 3, len(image), 2835, 2835, 0, 0)
+    header += struct.pack("<IIII", 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000)
+    header += b"BGRs" + bytes(36) + bytes(12)
+    offset = 14 + len(header)
+    with open(path, "wb") as out:
+        out.write(struct.pack("<2sIHHI", b"BM", offset + len(image), 0, 0, offset))
+        out.write(header)
+        out.write(image)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__.strip().splitlines()[-1])
+    width, height = CELL * len(NAMES), CELL * len(COLORS)
+    atlas = [(0, 0, 0, 0)] * (width * height)
+    for row, color in enumerate(COLORS):
+        for col, name in enumerate(NAMES):
+            cell = fit(*read_png("%s/%s_%s.png" % (sys.argv[1], color, name)))
+            for y in range(CELL):
+                start = (row * CELL + y) * width + col * CELL
+                atlas[start:start + CELL] = cell[y * CELL:(y + 1) * CELL]
+    write_bmp(sys.argv[2], width, height, atlas)
+
+
+if __name__ == "__main__":
+    main()
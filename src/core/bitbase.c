@@ -0,0 +1,550 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bitbase.h"
+
+#define BITBASE_MAGIC 0x31424243u   /** "CBB1" */
+#define BITBASE_VERSION 1
+#define MAX_MEN 2                   /** strong-side pieces besides the king */
+#define MAX_GENERATOR_THREADS 64
+
+/**
+ * Ending - a material signature: a lone king against a king and MAX_MEN
+ * or fewer men. Tables are stored with the strong side as white.
+ */
+typedef struct {
+    const char* name;
+    int menCount;
+    PieceType men[MAX_MEN];
+} Ending;
+
+/* Generated in this order: KPK promotes into the two before it. Every
+ * capture by the lone king leaves a bare king or a lone minor, so no
+ * ending here depends on a smaller one through a capture. */
+static const Ending Endings[] = {
+    {"KQK", 1, {QUEEN}},
+    {"KRK", 1, {ROOK}},
+    {"KPK", 1, {PAWN}},
+    {"KBNK", 2, {BISHOP, KNIGHT}},
+};
+
+#define ENDING_NB ((int)(sizeof(Endings) / sizeof(Endings[0])))
+
+/**
+ * Table - one ending's verdicts. A config packs the strong king into
+ * bits 0-5 and each man into the next six bits; for every config and
+ * side to move a 64-bit word holds one bit per square of the lone
+ * king, set when the strong side wins.
+ */
+typedef struct {
+    size_t configs;
+    const uint64_t* wins[2];    /** [0] strong side to move, [1] lone king to move */
+} Table;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tableCount;
+    uint32_t reserved;
+} FileHeader;
+
+typedef struct {
+    char name[8];
+    uint64_t configs;
+} TableHeader;
+
+static Table Tables[ENDING_NB];
+static void* Mapping;
+static size_t MappingSize;
+static uint64_t* Generated[ENDING_NB][2];  /** tables kept in memory when no file could be written */
+
+static inline size_t configCount(const Ending* ending) {
+    return (size_t)1 << (6 * (ending->menCount + 1));
+}
+
+static inline int configSquare(size_t config, int index) {
+    return (int)((config >> (6 * index)) & 63);
+}
+
+static inline size_t configMove(size_t config, int index, int to) {
+    return (config & ~((size_t)63 << (6 * index))) | (size_t)to << (6 * index);
+}
+
+/* Squares a king on any square of @b attacks */
+static inline Bitboard kingSpread(Bitboard b) {
+    Bitboard sides = ((b << 1) & ~COL_A_BB) | ((b >> 1) & ~COL_H_BB);
+
+    b |= sides;
+    return sides | (b << 8) | (b >> 8);
+}
+
+static Bitboard manAttacks(PieceType type, int square, Bitboard occupied) {
+    switch (type) {
+        case PAWN: return PawnAttacks[WHITE][square];
+        case KNIGHT: return KnightAttacks[square];
+        case BISHOP: return bishopAttacks(square, occupied);
+        case ROOK: return rookAttacks(square, occupied);
+        case QUEEN: return queenAttacks(square, occupied);
+        default: return 0;
+    }
+}
+
+/**
+ * Generator - one ending being solved. legal[] holds, per config, the
+ * squares the lone king may stand on (0 for an impossible config) and
+ * attacked[] what the strong side attacks with the lone king off the
+ * board, so a king step along a slider's line is seen as attacked.
+ */
+typedef struct {
+    const Ending* ending;
+    int index;
+    size_t configs;
+    uint64_t* wins[2];
+    Bitboard* legal;
+    Bitboard* attacked;
+} Generator;
+
+typedef struct {
+    Generator* generator;
+    void (*phase)(Generator*, size_t, size_t, bool*);
+    size_t begin, end;
+    bool changed;
+} Slice;
+
+static void setupConfigs(Generator* generator, size_t begin, size_t end, bool* changed) {
+    const Ending* ending = generator->ending;
+    (void)changed;
+
+    for (size_t config = begin; config < end; ++config) {
+        int king = configSquare(config, 0);
+        Bitboard occupied = SQUARE_BB(king), attacked = KingAttacks[king];
+        bool valid = true;
+
+        for (int i = 0; i < ending->menCount; ++i) {
+            int square = configSquare(config, i + 1);
+
+            if ((occupied & SQUARE_BB(square)) || (ending->men[i] == PAWN && (ROW_OF(square) == 0 || ROW_OF(square) == 7))) {
+                valid = false;
+            }
+            occupied |= SQUARE_BB(square);
+        }
+        for (int i = 0; i < ending->menCount && valid; ++i) {
+            attacked |= manAttacks(ending->men[i], configSquare(config, i + 1), occupied);
+        }
+        generator->legal[config] = valid ? ~(occupied | KingAttacks[king]) : 0;
+        generator->attacked[config] = attacked;
+    }
+}
+
+/**
+ * loneKingPhase - the lone king to move loses when it is mated, or when
+ * every step it has (captures of undefended men included, which never
+ * lose) lands in a strong-to-move win
+ */
+static void loneKingPhase(Generator* generator, size_t begin, size_t end, bool* changed) {
+    for (size_t config = begin; config < end; ++config) {
+        Bitboard legal = generator->legal[config], attacked = generator->attacked[config];
+        Bitboard free, escapes, wins;
+
+        if (!legal) continue;
+        free = ~attacked & ~SQUARE_BB(configSquare(config, 0));
+        escapes = free & ~generator->wins[0][config];
+        wins = legal & ~kingSpread(escapes) & (kingSpread(free) | attacked);
+        if (wins != generator->wins[1][config]) {
+            generator->wins[1][config] = wins;
+            *changed = true;
+        }
+    }
+}
+
+/**
+ * strongPhase - the strong side to move wins when some move reaches a
+ * lone-king-to-move loss; a slider's move only counts where the lone
+ * king does not stand in its path
+ */
+static void strongPhase(Generator* generator, size_t begin, size_t end, bool* changed) {
+    const Ending* ending = generator->ending;
+    const uint64_t* next = generator->wins[1];
+
+    for (size_t config = begin; config < end; ++config) {
+        Bitboard legal = generator->legal[config] & ~generator->attacked[config];
+        int king = configSquare(config, 0);
+        Bitboard occupied = SQUARE_BB(king), targets, wins = 0;
+
+        if (!legal) continue;
+        for (int i = 0; i < ending->menCount; ++i) {
+            occupied |= SQUARE_BB(configSquare(config, i + 1));
+        }
+
+        targets = KingAttacks[king] & ~occupied;
+        while (targets) {
+            wins |= next[configMove(config, 0, popLsb(&targets))];
+        }
+
+        for (int i = 0; i < ending->menCount; ++i) {
+            int from = configSquare(config, i + 1);
+
+            if (ending->men[i] != PAWN) {
+                targets = manAttacks(ending->men[i], from, occupied) & ~occupied;
+                while (targets) {
+                    int to = popLsb(&targets);
+                    wins |= next[configMove(config, i + 1, to)] & ~BetweenBB[from][to];
+                }
+                continue;
+            }
+
+            if (occupied & SQUARE_BB(from + 8)) continue;
+            if (ROW_OF(from) == 6) {
+                /* Promote to a queen or rook and look the result up in
+                 * that ending, already solved */
+                for (int e = 0; e < generator->index; ++e) {
+                    if (Endings[e].menCount == ending->menCount && ending->menCount == 1
+                        && (Endings[e].men[0] == QUEEN || Endings[e].men[0] == ROOK)) {
+                        wins |= Tables[e].wins[1][configMove(config, i + 1, from + 8)];
+                    }
+                }
+                continue;
+            }
+            wins |= next[configMove(config, i + 1, from + 8)];
+            if (ROW_OF(from) == 1 && !(occupied & SQUARE_BB(from + 16))) {
+                wins |= next[configMove(config, i + 1, from + 16)] & ~SQUARE_BB(from + 8);
+            }
+        }
+
+        wins &= legal;
+        if (wins & ~generator->wins[0][config]) {
+            generator->wins[0][config] |= wins;
+            *changed = true;
+        }
+    }
+}
+
+static void* sliceMain(void* arg) {
+    Slice* slice = arg;
+
+    slice->phase(slice->generator, slice->begin, slice->end, &slice->changed);
+    return NULL;
+}
+
+/**
+ * runPhase - applies @phase to every config, split into one contiguous
+ * slice per thread. Each phase reads only the other side's words, so
+ * the slices never touch what another slice writes.
+ *
+ * Return: whether any word changed
+ */
+static bool runPhase(Generator* generator, void (*phase)(Generator*, size_t, size_t, bool*), int threads) {
+    Slice slices[MAX_GENERATOR_THREADS];
+    pthread_t handles[MAX_GENERATOR_THREADS];
+    bool started[MAX_GENERATOR_THREADS];
+    bool changed = false;
+
+    for (int i = 0; i < threads; ++i) {
+        slices[i].generator = generator;
+        slices[i].phase = phase;
+        slices[i].begin = generator->configs * (size_t)i / (size_t)threads;
+        slices[i].end = generator->configs * (size_t)(i + 1) / (size_t)threads;
+        slices[i].changed = false;
+        started[i] = i > 0 && pthread_create(&handles[i], NULL, sliceMain, &slices[i]) == 0;
+    }
+    for (int i = 0; i < threads; ++i) {
+        if (!started[i]) sliceMain(&slices[i]);
+    }
+    for (int i = 1; i < threads; ++i) {
+        if (started[i]) pthread_join(handles[i], NULL);
+        changed = changed || slices[i].changed;
+    }
+    return changed || slices[0].changed;
+}
+
+/**
+ * solveEnding - retrograde analysis by repeated sweeps: alternate the
+ * two sides' phases until neither finds a new win. Positions never
+ * marked are draws.
+ */
+static bool solveEnding(int index, int threads, uint64_t* wins[2]) {
+    Generator generator = {&Endings[index], index, configCount(&Endings[index]), {NULL, NULL}, NULL, NULL};
+    bool changed = true;
+
+    generator.wins[0] = wins[0] = calloc(generator.configs, sizeof(uint64_t));
+    generator.wins[1] = wins[1] = calloc(generator.configs, sizeof(uint64_t));
+    generator.legal = malloc(generator.configs * sizeof(Bitboard));
+    generator.attacked = malloc(generator.configs * sizeof(Bitboard));
+    if (!wins[0] || !wins[1] || !generator.legal || !generator.attacked) {
+        free(generator.legal);
+        free(generator.attacked);
+        return false;
+    }
+
+    runPhase(&generator, setupConfigs, threads);
+    while (changed) {
+        changed = runPhase(&generator, loneKingPhase, threads);
+        changed = runPhase(&generator, strongPhase, threads) || changed;
+    }
+
+    free(generator.legal);
+    free(generator.attacked);
+    return true;
+}
+
+/**
+ * bitbaseGenerate - solves every ending on @threads threads (all cores
+ * when < 1) and makes the tables current, then writes them to @path
+ * through a temporary file, so a reader never maps half a file. The
+ * file is in native byte order: it is a local cache, rebuilt wherever
+ * it is missing.
+ *
+ * Return: false if memory ran out (no tables) or the file could not be
+ *         written (the tables are still in use, from memory)
+ */
+bool bitbaseGenerate(const char* path, int threads) {
+    FileHeader header = {BITBASE_MAGIC, BITBASE_VERSION, ENDING_NB, 0};
+    char temporary[BITBASE_PATH_MAX + 32];
+    bool ok = true;
+    FILE* file;
+
+    if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_GENERATOR_THREADS) threads = MAX_GENERATOR_THREADS;
+
+    bitbaseFree();
+    for (int i = 0; i < ENDING_NB && ok; ++i) {
+        ok = solveEnding(i, threads, Generated[i]);
+        Tables[i].configs = configCount(&Endings[i]);
+        Tables[i].wins[0] = Generated[i][0];
+        Tables[i].wins[1] = Generated[i][1];
+    }
+    if (!ok) {
+        bitbaseFree();
+        return false;
+    }
+
+    /* Engines sharing one cache directory may all be building the file */
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+    if (!(file = fopen(temporary, "wb"))) return false;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < ENDING_NB && ok; ++i) {
+        TableHeader table = {{0}, Tables[i].configs};
+
+        strncpy(table.name, Endings[i].name, sizeof(table.name) - 1);
+        ok = fwrite(&table, sizeof(table), 1, file) == 1
+          && fwrite(Tables[i].wins[0], sizeof(uint64_t), Tables[i].configs, file) == Tables[i].configs
+          && fwrite(Tables[i].wins[1], sizeof(uint64_t), Tables[i].configs, file) == Tables[i].configs;
+    }
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && rename(temporary, path) == 0;
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+/**
+ * bitbaseLoad - maps the tables in @path; the mapping is read-only and
+ * shared by every search thread
+ *
+ * Return: false if the file is missing, truncated or from another version
+ */
+bool bitbaseLoad(const char* path) {
+    const FileHeader* header;
+    const uint8_t* cursor;
+    struct stat info;
+    void* data;
+    int fd;
+
+    bitbaseFree();
+    if ((fd = open(path, O_RDONLY)) < 0) return false;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+    data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    header = data;
+    cursor = (const uint8_t*)data + sizeof(FileHeader);
+    if (header->magic != BITBASE_MAGIC || header->version != BITBASE_VERSION || header->tableCount != ENDING_NB) {
+        munmap(data, (size_t)info.st_size);
+        return false;
+    }
+    for (int i = 0; i < ENDING_NB; ++i) {
+        const TableHeader* table = (const TableHeader*)cursor;
+        size_t configs = configCount(&Endings[i]);
+
+        if ((size_t)(cursor - (const uint8_t*)data) + sizeof(TableHeader) + 2 * configs * sizeof(uint64_t)
+                > (size_t)info.st_size
+            || strncmp(table->name, Endings[i].name, sizeof(table->name)) != 0 || table->configs != configs) {
+            memset(Tables, 0, sizeof(Tables));
+            munmap(data, (size_t)info.st_size);
+            return false;
+        }
+        cursor += sizeof(TableHeader);
+        Tables[i].configs = configs;
+        Tables[i].wins[0] = (const uint64_t*)cursor;
+        Tables[i].wins[1] = (const uint64_t*)cursor + configs;
+        cursor += 2 * configs * sizeof(uint64_t);
+    }
+
+    Mapping = data;
+    MappingSize = (size_t)info.st_size;
+    return true;
+}
+
+/* mkdir -p: creates @path and any missing parents */
+static bool makeDirectories(char* path) {
+    for (char* slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        bool made;
+
+        *slash = '\0';
+        made = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *slash = '/';
+        if (!made) return false;
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * bitbaseDefaultPath - where front ends keep the tables when not told
+ * otherwise: $CHESS_BITBASES if set, else bitbases.bin in the user's
+ * cache directory, which is created if missing. Never the working
+ * directory, which belongs to whoever started the program.
+ *
+ * Return: false if there is no such place (no environment to go by, or
+ *         the directory cannot be created)
+ */
+bool bitbaseDefaultPath(char* path, size_t size) {
+    const char* override = getenv(BITBASE_PATH_ENV);
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    int length;
+
+    if (override && *override) return snprintf(path, size, "%s", override) < (int)size;
+    if (cache && *cache == '/') {
+        length = snprintf(path, size, "%s/%s", cache, BITBASE_CACHE_DIR);
+    } else if (home && *home == '/') {
+        length = snprintf(path, size, "%s/.cache/%s", home, BITBASE_CACHE_DIR);
+    } else {
+        return false;
+    }
+    if (length < 0 || (size_t)length >= size || !makeDirectories(path)) return false;
+    return snprintf(path + length, size - (size_t)length, "/%s", BITBASE_DEFAULT_FILE) < (int)(size - (size_t)length);
+}
+
+/**
+ * bitbaseInit - maps the tables at @path, or generates them when the
+ * file is missing or stale; call once at startup, before searching
+ *
+ * Return: false if the tables could neither be loaded nor built
+ */
+bool bitbaseInit(const char* path, int threads) {
+    if (bitbaseLoad(path)) return true;
+
+    /* Freshly built tables are used from memory; the file serves the
+     * next start */
+    bitbaseGenerate(path, threads);
+    return Tables[0].wins[0] != NULL;
+}
+
+void bitbaseFree(void) {
+    if (Mapping) munmap(Mapping, MappingSize);
+    Mapping = NULL;
+    MappingSize = 0;
+    for (int i = 0; i < ENDING_NB; ++i) {
+        free(Generated[i][0]);
+        free(Generated[i][1]);
+        Generated[i][0] = Generated[i][1] = NULL;
+    }
+    memset(Tables, 0, sizeof(Tables));
+}
+
+/**
+ * bitbaseProbe - looks @pos up when it is one of the covered endings.
+ * Positions with castling rights are left to the search, the tables do
+ * not know about castling.
+ */
+BitbaseResult bitbaseProbe(const Position* pos) {
+    Bitboard occupied = positionOccupied(pos);
+    Bitboard kings = positionPieces(pos, WHITE, KING) | positionPieces(pos, BLACK, KING);
+    PieceColor strong;
+    int flip;
+
+    if (!Tables[0].wins[0] || popCount(occupied) > MAX_MEN + 2 || pos->castlingRights) return BITBASE_UNKNOWN;
+    if ((occupied & ~kings & pos->byColor[WHITE]) && (occupied & ~kings & pos->byColor[BLACK])) return BITBASE_UNKNOWN;
+    strong = (occupied & ~kings & pos->byColor[BLACK]) ? BLACK : WHITE;
+    flip = (strong == WHITE) ? 0 : 56;
+
+    for (int e = 0; e < ENDING_NB; ++e) {
+        const Ending* ending = &Endings[e];
+        size_t config = (size_t)(pos->kingSquare[strong] ^ flip);
+        Bitboard men = occupied & ~kings;
+        int side, weakKing;
+
+        if (popCount(men) != ending->menCount) continue;
+        for (int i = 0; i < ending->menCount; ++i) {
+            Bitboard ofType = men & positionPieces(pos, strong, ending->men[i]);
+
+            if (!ofType) break;
+            men &= ~SQUARE_BB(lsb(ofType));
+            config = configMove(config, i + 1, lsb(ofType) ^ flip);
+        }
+        if (men) continue;
+
+        side = (pos->sideToMove == strong) ? 0 : 1;
+        weakKing = pos->kingSquare[OPPONENT(strong)] ^ flip;
+        if (!((Tables[e].wins[side][config] >> weakKing) & 1)) return BITBASE_DRAW;
+        return (pos->sideToMove == strong) ? BITBASE_WIN : BITBASE_LOSS;
+    }
+    return BITBASE_UNKNOWN;
+}
+
+static inline int centreDistance(int square) {
+    int row = ROW_OF(square), col = COL_OF(square);
+
+    return (row < 4 ? 3 - row : row - 4) + (col < 4 ? 3 - col : col - 4);
+}
+
+static inline int kingDistance(int a, int b) {
+    int rows = abs(ROW_OF(a) - ROW_OF(b)), cols = abs(COL_OF(a) - COL_OF(b));
+
+    return rows > cols ? rows : cols;
+}
+
+/**
+ * bitbaseScore - a search score for a probed result. A win is worth
+ * VALUE_KNOWN_WIN plus a push towards actually winning: the lone king
+ * driven to the edge (for KBNK, to a corner the bishop controls), the
+ * kings brought together and a pawn advanced.
+ */
+int bitbaseScore(const Position* pos, BitbaseResult result) {
+    PieceColor strong, weak;
+    Bitboard pawns, bishops;
+    int score, strongKing, weakKing;
+
+    if (result != BITBASE_WIN && result != BITBASE_LOSS) return 0;
+
+    strong = (result == BITBASE_WIN) ? pos->sideToMove : OPPONENT(pos->sideToMove);
+    weak = OPPONENT(strong);
+    strongKing = pos->kingSquare[strong];
+    weakKing = pos->kingSquare[weak];
+    score = VALUE_KNOWN_WIN + 20 * centreDistance(weakKing) + 10 * (7 - kingDistance(strongKing, weakKing));
+
+    if ((pawns = positionPieces(pos, strong, PAWN))) {
+        int row = ROW_OF(lsb(pawns));
+        score += 20 * ((strong == WHITE) ? row : 7 - row);
+    }
+    if ((bishops = positionPieces(pos, strong, BISHOP)) && positionPieces(pos, strong, KNIGHT)) {
+        /* a1 is dark: a dark-squared bishop mates in a1 or h8 */
+        bool dark = ((ROW_OF(lsb(bishops)) + COL_OF(lsb(bishops))) & 1) == 0;
+        int first = dark ? SQUARE(0, 0) : SQUARE(7, 0), second = dark ? SQUARE(7, 7) : SQUARE(0, 7);
+        int corner = kingDistance(weakKing, first) < kingDistance(weakKing, second)
+                   ? kingDistance(weakKing, first) : kingDistance(weakKing, second);
+
+        score += 30 * (7 - corner);
+    }
+    return (result == BITBASE_WIN) ? score : -score;
+}
@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include "bitboard.h"
+#include "position.h"
+#include "misc.h"
+
+Bitboard KnightAttacks[64];
+Bitboard KingAttacks[64];
+Bitboard PawnAttacks[3][64];
+Magic BishopMagics[64];
+Magic RookMagics[64];
+Bitboard BetweenBB[64][64];
+Bitboard LineBB[64][64];
+
+static Bitboard bishopTable[0x1480];
+static Bitboard rookTable[0x19000];
+
+static const int knightSteps[8][2] = {
+    {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+};
+static const int kingSteps[8][2] = {
+    {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+static const int rookSteps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int bishopSteps[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static bool onBoard(int row, int col) {
+    return row >= 0 && row < BOARD_SIZE && col >= 0 && col < BOARD_SIZE;
+}
+
+static Bitboard stepAttacks(int square, const int steps[][2], int count) {
+    Bitboard attacks = 0;
+    for (int i = 0; i < count; ++i) {
+        int row = ROW_OF(square) + steps[i][0], col = COL_OF(square) + steps[i][1];
+        if (onBoard(row, col)) {
+            attacks |= SQUARE_BB(SQUARE(row, col));
+        }
+    }
+    return attacks;
+}
+
+static Bitboard slidingAttacks(int square, Bitboard occupied, const int steps[4][2]) {
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; ++d) {
+        int row = ROW_OF(square) + steps[d][0], col = COL_OF(square) + steps[d][1];
+        while (onBoard(row, col)) {
+            attacks |= SQUARE_BB(SQUARE(row, col));
+            if (occupied & SQUARE_BB(SQUARE(row, col))) break;
+            row += steps[d][0];
+            col += steps[d][1];
+        }
+    }
+    return attacks;
+}
+
+static void initMagics(Magic magics[64], Bitboard* table, const int steps[4][2]) {
+    static Bitboard reference[4096];
+#ifndef USE_PEXT
+    static Bitboard occupancy[4096];
+    static int epoch[4096];
+    static int attempt = 0;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+#endif
+
+    for (int square = 0; square < SQUARE_NB; ++square) {
+        Magic* m = &magics[square];
+        Bitboard edges = ((ROW_1_BB | ROW_8_BB) & ~(ROW_1_BB << (8 * ROW_OF(square))))
+                       | ((COL_A_BB | COL_H_BB) & ~(COL_A_BB << COL_OF(square)));
+        int size = 0;
+
+        m->mask = slidingAttacks(square, 0, steps) & ~edges;
+        m->shift = 64 - popCount(m->mask);
+        m->attacks = (square == 0) ? table : magics[square - 1].attacks + (1u << (64 - magics[square - 1].shift));
+
+        /* Carry-rippler enumeration of every subset of the mask */
+        Bitboard b = 0;
+        do {
+            reference[size] = slidingAttacks(square, b, steps);
+#ifdef USE_PEXT
+            m->attacks[_pext_u64(b, m->mask)] = reference[size];
+#else
+            occupancy[size] = b;
+#endif
+            size++;
+            b = (b - m->mask) & m->mask;
+        } while (b);
+
+#ifndef USE_PEXT
+        for (int i = 0; i < size;) {
+            do {
+                m->magic = randomNext(&seed) & randomNext(&seed) & randomNext(&seed);
+            } while (popCount((m->mask * m->magic) >> 56) < 6);
+
+            ++attempt;
+            for (i = 0; i < size; ++i) {
+                unsigned index = magicIndex(m, occupancy[i]);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    m->attacks[index] = reference[i];
+                } else if (m->attacks[index] != reference[i]) {
+                    break;
+                }
+            }
+        }
+#endif
+    }
+}
+
+/**
+ * bitboardInit - fills the leaper attack tables and finds the sliding
+ * piece magics; run from chessCoreInit
+ */
+void bitboardInit(void) {
+    static bool initialized = false;
+    if (initialized) return;
+
+    for (int square = 0; square < SQUARE_NB; ++square) {
+        static const int whitePawnSteps[2][2] = {{1, -1}, {1, 1}};
+        static const int blackPawnSteps[2][2] = {{-1, -1}, {-1, 1}};
+
+        KnightAttacks[square] = stepAttacks(square, knightSteps, 8);
+        KingAttacks[square] = stepAttacks(square, kingSteps, 8);
+        PawnAttacks[WHITE][square] = stepAttacks(square, whitePawnSteps, 2);
+        PawnAttacks[BLACK][square] = stepAttacks(square, blackPawnSteps, 2);
+    }
+
+    initMagics(BishopMagics, bishopTable, bishopSteps);
+    initMagics(RookMagics, rookTable, rookSteps);
+
+    for (int a = 0; a < SQUARE_NB; ++a) {
+        for (int b = 0; b < SQUARE_NB; ++b) {
+            if (bishopAttacks(a, 0) & SQUARE_BB(b)) {
+                LineBB[a][b] = (bishopAttacks(a, 0) & bishopAttacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
+                BetweenBB[a][b] = bishopAttacks(a, SQUARE_BB(b)) & bishopAttacks(b, SQUARE_BB(a));
+            } else if (rookAttacks(a, 0) & SQUARE_BB(b)) {
+                LineBB[a][b] = (rookAttacks(a, 0) & rookAttacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
+                BetweenBB[a][b] = rookAttacks(a, SQUARE_BB(b)) & rookAttacks(b, SQUARE_BB(a));
+            }
+        }
+    }
+    initialized = true;
+}
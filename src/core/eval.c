@@ -0,0 +1,220 @@
+#include <stddef.h>
+#include "eval.h"
+#include "nnue.h"
+#include "stats.h"
+
+const int PieceValue[KING + 1] = {
+    0, PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, 0
+};
+
+static const int EndgameValue[KING + 1] = {0, 120, 300, 320, 520, 920, 0};
+static const int PhaseWeight[KING + 1] = {0, 0, 1, 1, 2, 4, 0};
+
+Score PieceSquare[PIECE_NB][SQUARE_NB];
+
+/*
+ * Piece-square tables from white's side, written with rank 8 on top
+ * the way a board is read. Knights, bishops, rooks and queens share one
+ * table for both phases; pawns and the king change their minds.
+ */
+static const int PawnMg[SQUARE_NB] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int PawnEg[SQUARE_NB] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     80,  80,  80,  80,  80,  80,  80,  80,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     15,  15,  15,  15,  15,  15,  15,  15,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int KnightTable[SQUARE_NB] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+};
+
+static const int BishopTable[SQUARE_NB] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20
+};
+
+static const int RookTable[SQUARE_NB] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0
+};
+
+static const int QueenTable[SQUARE_NB] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+static const int KingMg[SQUARE_NB] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20
+};
+
+static const int KingEg[SQUARE_NB] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50
+};
+
+/* Mobility: per reachable square beyond a typical count */
+static const int MobilityMg[KING + 1] = {0, 0, 4, 5, 2, 1, 0};
+static const int MobilityEg[KING + 1] = {0, 0, 4, 5, 4, 2, 0};
+static const int MobilityBase[KING + 1] = {0, 0, 4, 7, 7, 14, 0};
+
+/* King safety: weight of each attacker type on the king zone */
+static const int KingAttackWeight[KING + 1] = {0, 0, 2, 2, 3, 5, 0};
+
+static const int* const MgTables[KING + 1] = {NULL, PawnMg, KnightTable, BishopTable, RookTable, QueenTable, KingMg};
+static const int* const EgTables[KING + 1] = {NULL, PawnEg, KnightTable, BishopTable, RookTable, QueenTable, KingEg};
+
+/**
+ * evalInit - builds the piece-square tables; called from chessCoreInit
+ */
+void evalInit(void) {
+    for (PieceType type = PAWN; type <= KING; ++type) {
+        for (int square = 0; square < SQUARE_NB; ++square) {
+            /* Tables are printed rank 8 first, so white reads them
+             * upside down and black, mirrored, reads them as written */
+            int index = SQUARE(BOARD_SIZE - 1 - ROW_OF(square), COL_OF(square));
+
+            PieceSquare[MAKE_PIECE(WHITE, type)][square] =
+                MAKE_SCORE(PieceValue[type] + MgTables[type][index], EndgameValue[type] + EgTables[type][index]);
+            PieceSquare[MAKE_PIECE(BLACK, type)][square] =
+                -MAKE_SCORE(PieceValue[type] + MgTables[type][square], EndgameValue[type] + EgTables[type][square]);
+        }
+    }
+}
+
+/**
+ * evaluatePieces - mobility of @us, and the pressure its pieces put on
+ * the enemy king zone (added to @kingAttack as weighted hits)
+ */
+static Score evaluatePieces(const Position* pos, PieceColor us, int* kingAttack) {
+    PieceColor them = OPPONENT(us);
+    Bitboard occupied = positionOccupied(pos);
+    Bitboard theirPawns = positionPieces(pos, them, PAWN);
+    Bitboard pawnAttacks = (them == WHITE) ? ((theirPawns << 7) & ~COL_H_BB) | ((theirPawns << 9) & ~COL_A_BB)
+                                           : ((theirPawns >> 9) & ~COL_H_BB) | ((theirPawns >> 7) & ~COL_A_BB);
+    Bitboard safe = ~(pos->byColor[us] | pawnAttacks);
+    Bitboard kingZone = KingAttacks[pos->kingSquare[them]] | SQUARE_BB(pos->kingSquare[them]);
+    int attackers = 0, weight = 0;
+    Score score = 0;
+
+    for (PieceType type = KNIGHT; type <= QUEEN; ++type) {
+        Bitboard pieces = positionPieces(pos, us, type);
+
+        while (pieces) {
+            int square = popLsb(&pieces);
+            Bitboard attacks = (type == KNIGHT) ? KnightAttacks[square]
+                             : (type == BISHOP) ? bishopAttacks(square, occupied)
+                             : (type == ROOK) ? rookAttacks(square, occupied)
+                             : queenAttacks(square, occupied);
+            int mobility = popCount(attacks & safe) - MobilityBase[type];
+
+            score += MAKE_SCORE(MobilityMg[type] * mobility, MobilityEg[type] * mobility);
+            if (attacks & kingZone) {
+                attackers++;
+                weight += KingAttackWeight[type] * popCount(attacks & kingZone);
+            }
+        }
+    }
+
+    /* A lone attacker is rarely dangerous; more grow quadratically */
+    *kingAttack = (attackers >= 2) ? weight * weight : 0;
+    return score;
+}
+
+static int gamePhase(const Position* pos) {
+    int phase = 0;
+
+    for (PieceType type = KNIGHT; type <= QUEEN; ++type) {
+        phase += PhaseWeight[type] * (pos->pieceCount[MAKE_PIECE(WHITE, type)] + pos->pieceCount[MAKE_PIECE(BLACK, type)]);
+    }
+    return (phase < PHASE_MAX) ? phase : PHASE_MAX;
+}
+
+/**
+ * evaluateClassic - the handcrafted evaluation. Material and
+ * piece-square terms come for free from the incrementally kept pos->psq
+ * and pawn structure from @pawns (may be NULL); the rest is computed
+ * here and tapered between midgame and endgame by the remaining
+ * material.
+ */
+static int evaluateClassic(const Position* pos, PawnTable* pawns) {
+    PawnEntry scratch, *entry = pawnProbe(pawns, pos, &scratch);
+    int whiteAttack, blackAttack;
+    Score score = pos->psq + entry->score;
+    int phase, value;
+
+    score += evaluatePieces(pos, WHITE, &whiteAttack) - evaluatePieces(pos, BLACK, &blackAttack);
+    score += pawnShelter(entry, pos, WHITE) - pawnShelter(entry, pos, BLACK);
+    score += MAKE_SCORE(whiteAttack / 4 < 500 ? whiteAttack / 4 : 500, 0);
+    score -= MAKE_SCORE(blackAttack / 4 < 500 ? blackAttack / 4 : 500, 0);
+
+    phase = gamePhase(pos);
+    value = (mgValue(score) * phase + egValue(score) * (PHASE_MAX - phase)) / PHASE_MAX;
+    return ((pos->sideToMove == WHITE) ? value : -value) + TEMPO;
+}
+
+/**
+ * evaluate - static score of @pos in centipawns from the point of view
+ * of the side to move: the network's when the position carries an
+ * accumulator stack (see nnue.h), the handcrafted one otherwise
+ */
+int evaluate(const Position* pos, PawnTable* pawns) {
+    STATS_TIMER(start);
+    int value = pos->nnue ? nnueEvaluate(pos) : evaluateClassic(pos, pawns);
+
+    STATS_INC(STAT_EVAL_CALLS);
+    STATS_TIME(STAT_EVAL_NS, start);
+    return value;
+}
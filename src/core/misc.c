@@ -0,0 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "misc.h"
+
+/**
+ * timeNowMs - monotonic clock in milliseconds, for timing searches and
+ * benchmarks (not wall-clock time)
+ */
+int64_t timeNowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * randomNext - xorshift64* step; callers keep their own fixed seed so
+ * tables built from it come out the same on every run
+ */
+uint64_t randomNext(uint64_t* seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 2685821657736338717ULL;
+}
@@ -0,0 +1,341 @@
+#include <string.h>
+#include "movegen.h"
+#include "stats.h"
+
+/**
+ * LegalInfo - what makes a move legal, worked out once per node: the
+ * pieces giving check, our pieces pinned to the king, the squares the
+ * enemy attacks (seen through our king) and where non-king moves must
+ * land to answer a check
+ */
+typedef struct {
+    PieceColor us;
+    int king;
+    Bitboard checkers;
+    Bitboard pinned;
+    Bitboard attacked;
+    Bitboard evasions;
+} LegalInfo;
+
+static Bitboard attackedSquares(const Position* pos, PieceColor by, Bitboard occupied) {
+    Bitboard pawns = positionPieces(pos, by, PAWN);
+    Bitboard attacked = (by == WHITE) ? ((pawns << 7) & ~COL_H_BB) | ((pawns << 9) & ~COL_A_BB)
+                                      : ((pawns >> 9) & ~COL_H_BB) | ((pawns >> 7) & ~COL_A_BB);
+    Bitboard pieces;
+
+    pieces = positionPieces(pos, by, KNIGHT);
+    while (pieces) attacked |= KnightAttacks[popLsb(&pieces)];
+    pieces = pos->byColor[by] & (pos->byType[BISHOP] | pos->byType[QUEEN]);
+    while (pieces) attacked |= bishopAttacks(popLsb(&pieces), occupied);
+    pieces = pos->byColor[by] & (pos->byType[ROOK] | pos->byType[QUEEN]);
+    while (pieces) attacked |= rookAttacks(popLsb(&pieces), occupied);
+    return attacked | KingAttacks[pos->kingSquare[by]];
+}
+
+static void computeLegalInfo(const Position* pos, LegalInfo* info) {
+    PieceColor us = pos->sideToMove, them = OPPONENT(us);
+    int king = pos->kingSquare[us];
+    Bitboard occupied = positionOccupied(pos);
+    Bitboard snipers = ((rookAttacks(king, 0) & (pos->byType[ROOK] | pos->byType[QUEEN]))
+                      | (bishopAttacks(king, 0) & (pos->byType[BISHOP] | pos->byType[QUEEN]))) & pos->byColor[them];
+
+    info->us = us;
+    info->king = king;
+    info->checkers = positionAttackersTo(pos, king, occupied) & pos->byColor[them];
+    info->pinned = 0;
+    while (snipers) {
+        Bitboard between = BetweenBB[king][popLsb(&snipers)] & occupied;
+        if (between && !(between & (between - 1))) info->pinned |= between & pos->byColor[us];
+    }
+    info->attacked = attackedSquares(pos, them, occupied ^ SQUARE_BB(king));
+    info->evasions = info->checkers ? BetweenBB[king][lsb(info->checkers)] | info->checkers : ~(Bitboard)0;
+}
+
+/* A pinned piece may only move along the line through its king */
+static inline bool leavesPin(const LegalInfo* info, int from, int to) {
+    return (info->pinned & SQUARE_BB(from)) && !(LineBB[info->king][from] & SQUARE_BB(to));
+}
+
+static inline void addMove(MoveList* list, int from, int to) {
+    list->moves[list->count++] = MAKE_MOVE(from, to);
+}
+
+static void addMovesFrom(MoveList* list, const LegalInfo* info, int from, Bitboard targets) {
+    if (info->pinned & SQUARE_BB(from)) targets &= LineBB[info->king][from];
+    while (targets) {
+        addMove(list, from, popLsb(&targets));
+    }
+}
+
+/* Quiescence only looks at queening; the full generator adds all four */
+static void addPromotions(MoveList* list, int from, int to, bool capturesOnly) {
+    list->moves[list->count++] = MAKE_PROMOTION(from, to, QUEEN);
+    if (capturesOnly) return;
+    list->moves[list->count++] = MAKE_PROMOTION(from, to, KNIGHT);
+    list->moves[list->count++] = MAKE_PROMOTION(from, to, ROOK);
+    list->moves[list->count++] = MAKE_PROMOTION(from, to, BISHOP);
+}
+
+/* En passant removes two pieces from one line, so it is checked by
+ * looking at the king through the board as it will be */
+static bool enPassantIsLegal(const Position* pos, const LegalInfo* info, int from) {
+    int to = pos->epSquare, captured = to ^ 8;
+    Bitboard occupied = (positionOccupied(pos) ^ SQUARE_BB(from) ^ SQUARE_BB(captured)) | SQUARE_BB(to);
+    Bitboard attackers = positionAttackersTo(pos, info->king, occupied) & pos->byColor[OPPONENT(info->us)];
+
+    return !(attackers & ~SQUARE_BB(captured));
+}
+
+static void generatePawnMoves(const Position* pos, MoveList* list, const LegalInfo* info, bool capturesOnly) {
+    PieceColor us = info->us;
+    Bitboard pawns = positionPieces(pos, us, PAWN);
+    Bitboard empty = ~positionOccupied(pos);
+    Bitboard enemies = pos->byColor[OPPONENT(us)] & info->evasions;
+    Bitboard lastRow = (us == WHITE) ? ROW_8_BB : ROW_1_BB;
+    int forward = (us == WHITE) ? 8 : -8;
+    Bitboard single, doubled;
+
+    if (us == WHITE) {
+        single = (pawns << 8) & empty;
+        doubled = ((single & (ROW_2_BB << 8)) << 8) & empty;
+    } else {
+        single = (pawns >> 8) & empty;
+        doubled = ((single & (ROW_7_BB >> 8)) >> 8) & empty;
+    }
+    single &= info->evasions;
+    doubled &= info->evasions;
+    if (capturesOnly) {
+        single &= lastRow;
+        doubled = 0;
+    }
+
+    while (single) {
+        int to = popLsb(&single);
+        if (leavesPin(info, to - forward, to)) continue;
+        if (SQUARE_BB(to) & lastRow) {
+            addPromotions(list, to - forward, to, capturesOnly);
+        } else {
+            addMove(list, to - forward, to);
+        }
+    }
+    while (doubled) {
+        int to = popLsb(&doubled);
+        if (!leavesPin(info, to - 2 * forward, to)) addMove(list, to - 2 * forward, to);
+    }
+    while (pawns) {
+        int from = popLsb(&pawns);
+        Bitboard targets = PawnAttacks[us][from] & enemies;
+
+        if (info->pinned & SQUARE_BB(from)) targets &= LineBB[info->king][from];
+        if (targets & lastRow) {
+            while (targets) {
+                addPromotions(list, from, popLsb(&targets), capturesOnly);
+            }
+        } else {
+            while (targets) {
+                addMove(list, from, popLsb(&targets));
+            }
+        }
+    }
+
+    if (pos->epSquare != SQUARE_NONE) {
+        Bitboard attackers = PawnAttacks[OPPONENT(us)][pos->epSquare] & positionPieces(pos, us, PAWN);
+        while (attackers) {
+            int from = popLsb(&attackers);
+            if (enPassantIsLegal(pos, info, from)) {
+                list->moves[list->count++] = MAKE_SPECIAL(from, pos->epSquare, MOVE_EN_PASSANT);
+            }
+        }
+    }
+}
+
+/* Castling needs empty squares between king and rook and a king that
+ * neither starts in, passes through nor lands in check */
+static void generateCastling(const Position* pos, MoveList* list, const LegalInfo* info) {
+    int king = info->king;
+    uint8_t kingSide = (info->us == WHITE) ? WHITE_OO : BLACK_OO;
+    uint8_t queenSide = (info->us == WHITE) ? WHITE_OOO : BLACK_OOO;
+    Bitboard occupied = positionOccupied(pos);
+
+    if (!(pos->castlingRights & (kingSide | queenSide)) || info->checkers) return;
+
+    if ((pos->castlingRights & kingSide)
+        && !(occupied & (SQUARE_BB(king + 1) | SQUARE_BB(king + 2)))
+        && !(info->attacked & (SQUARE_BB(king + 1) | SQUARE_BB(king + 2)))) {
+        list->moves[list->count++] = MAKE_SPECIAL(king, king + 2, MOVE_CASTLING);
+    }
+    if ((pos->castlingRights & queenSide)
+        && !(occupied & (SQUARE_BB(king - 1) | SQUARE_BB(king - 2) | SQUARE_BB(king - 3)))
+        && !(info->attacked & (SQUARE_BB(king - 1) | SQUARE_BB(king - 2)))) {
+        list->moves[list->count++] = MAKE_SPECIAL(king, king - 2, MOVE_CASTLING);
+    }
+}
+
+/**
+ * generate - writes only legal moves: in double check just king moves,
+ * in single check only captures of the checker, blocks and king moves,
+ * pinned pieces only along their pin, and king moves only to squares
+ * the enemy does not attack
+ */
+static int generate(const Position* pos, MoveList* list, bool capturesOnly) {
+    LegalInfo info;
+    Bitboard occupied = positionOccupied(pos);
+    Bitboard targets, pieces;
+
+    computeLegalInfo(pos, &info);
+    targets = capturesOnly ? pos->byColor[OPPONENT(info.us)] : ~pos->byColor[info.us];
+    list->count = 0;
+
+    if (!(info.checkers & (info.checkers - 1))) {
+        Bitboard pieceTargets = targets & info.evasions;
+
+        generatePawnMoves(pos, list, &info, capturesOnly);
+
+        pieces = positionPieces(pos, info.us, KNIGHT) & ~info.pinned;
+        while (pieces) {
+            int from = popLsb(&pieces);
+            addMovesFrom(list, &info, from, KnightAttacks[from] & pieceTargets);
+        }
+
+        pieces = pos->byColor[info.us] & (pos->byType[BISHOP] | pos->byType[QUEEN]);
+        while (pieces) {
+            int from = popLsb(&pieces);
+            addMovesFrom(list, &info, from, bishopAttacks(from, occupied) & pieceTargets);
+        }
+
+        /* Queens were given their diagonal moves above */
+        pieces = pos->byColor[info.us] & (pos->byType[ROOK] | pos->byType[QUEEN]);
+        while (pieces) {
+            int from = popLsb(&pieces);
+            addMovesFrom(list, &info, from, rookAttacks(from, occupied) & pieceTargets);
+        }
+
+        if (!capturesOnly) generateCastling(pos, list, &info);
+    }
+
+    addMovesFrom(list, &info, info.king, KingAttacks[info.king] & targets & ~info.attacked);
+    return list->count;
+}
+
+/**
+ * generateLegalMoves - every legal move for the side to move
+ *
+ * Return: number of moves written to @list
+ */
+int generateLegalMoves(const Position* pos, MoveList* list) {
+    STATS_TIMER(start);
+    int count = generate(pos, list, false);
+
+    STATS_INC(STAT_MOVEGEN_CALLS);
+    STATS_TIME(STAT_MOVEGEN_NS, start);
+    return count;
+}
+
+/**
+ * generateCaptures - the legal captures and queen promotions, for
+ * quiescence search
+ *
+ * Return: number of moves written to @list
+ */
+int generateCaptures(const Position* pos, MoveList* list) {
+    STATS_TIMER(start);
+    int count = generate(pos, list, true);
+
+    STATS_INC(STAT_MOVEGEN_CALLS);
+    STATS_TIME(STAT_MOVEGEN_NS, start);
+    return count;
+}
+
+/**
+ * positionFindMove - the legal move from @from to @to; a promotion
+ * becomes @promoted (any other type means queen)
+ *
+ * Return: the move, MOVE_NONE if there is no such legal move
+ */
+Move positionFindMove(const Position* pos, int from, int to, PieceType promoted) {
+    MoveList list;
+
+    if (from < 0 || from >= SQUARE_NB || to < 0 || to >= SQUARE_NB) return MOVE_NONE;
+    if (PIECE_COLOR(pos->board[from]) != pos->sideToMove) return MOVE_NONE;
+    if (promoted < KNIGHT || promoted > QUEEN) promoted = QUEEN;
+
+    generateLegalMoves(pos, &list);
+    for (int i = 0; i < list.count; ++i) {
+        Move move = list.moves[i];
+        if (MOVE_FROM(move) != from || MOVE_TO(move) != to) continue;
+        if (MOVE_TYPE(move) != MOVE_PROMOTION || MOVE_PROMOTED(move) == promoted) return move;
+    }
+    return MOVE_NONE;
+}
+
+bool positionIsLegalMove(const Position* pos, int from, int to) {
+    STATS_INC(STAT_LEGALITY_TESTS);
+    return positionFindMove(pos, from, to, QUEEN) != MOVE_NONE;
+}
+
+bool positionIsCheckMate(const Position* pos) {
+    MoveList list;
+    return positionInCheck(pos, pos->sideToMove) && generateLegalMoves(pos, &list) == 0;
+}
+
+bool positionIsStaleMate(const Position* pos) {
+    MoveList list;
+    return !positionInCheck(pos, pos->sideToMove) && generateLegalMoves(pos, &list) == 0;
+}
+
+/**
+ * moveToString - writes @move in coordinate notation ("e2e4", "e7e8q")
+ * to @buffer, which must hold at least 6 bytes
+ *
+ * Return: @buffer
+ */
+char* moveToString(Move move, char* buffer) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+
+    buffer[0] = (char)('a' + COL_OF(from));
+    buffer[1] = (char)('1' + ROW_OF(from));
+    buffer[2] = (char)('a' + COL_OF(to));
+    buffer[3] = (char)('1' + ROW_OF(to));
+    buffer[4] = (MOVE_TYPE(move) == MOVE_PROMOTION) ? " nbrq"[MOVE_PROMOTED(move) - PAWN] : '\0';
+    buffer[5] = '\0';
+    return buffer;
+}
+
+/**
+ * moveFromString - finds the legal move of @pos written as @text in
+ * coordinate notation
+ *
+ * Return: the move, MOVE_NONE if @text is not a legal move here
+ */
+Move moveFromString(const Position* pos, const char* text) {
+    MoveList list;
+    char buffer[6];
+
+    generateLegalMoves(pos, &list);
+    for (int i = 0; i < list.count; ++i) {
+        if (strcmp(moveToString(list.moves[i], buffer), text) == 0) return list.moves[i];
+    }
+    return MOVE_NONE;
+}
+
+/**
+ * perft - counts the leaf nodes of the legal move tree to @depth; the
+ * last ply is bulk-counted from the move list length
+ */
+uint64_t perft(Position* pos, int depth) {
+    MoveList list;
+    UndoInfo undo;
+    uint64_t nodes = 0;
+
+    if (depth <= 0) return 1;
+
+    generateLegalMoves(pos, &list);
+    if (depth == 1) return (uint64_t)list.count;
+
+    for (int i = 0; i < list.count; ++i) {
+        positionMakeMove(pos, list.moves[i], &undo);
+        nodes += perft(pos, depth - 1);
+        positionUnmakeMove(pos, list.moves[i], &undo);
+    }
+    return nodes;
+}
@@ -0,0 +1,473 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "nnue.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NNUE_X86
+#include <immintrin.h>
+#endif
+
+#define NNUE_MAGIC 0x314E4E43u      /** "CNN1" */
+#define NNUE_VERSION 1
+#define NNUE_ALIGNMENT 64
+
+/**
+ * Net - the quantized weights. The first layer is int16 so accumulators
+ * add and subtract rows exactly; the hidden layers are int8 weights over
+ * uint8 activations in [0, NNUE_RELU_MAX], summed in int32 with biases
+ * already scaled by 1 << NNUE_WEIGHT_SHIFT. Each row of a hidden layer
+ * holds the weights of one output.
+ */
+typedef struct {
+    int16_t ftBias[NNUE_HIDDEN];
+    int16_t ftWeights[NNUE_INPUTS][NNUE_HIDDEN];
+    int32_t l1Bias[NNUE_L2];
+    int8_t l1Weights[NNUE_L2][2 * NNUE_HIDDEN];
+    int32_t l2Bias[NNUE_L3];
+    int8_t l2Weights[NNUE_L3][NNUE_L2];
+    int32_t outBias;
+    int8_t outWeights[NNUE_L3];
+} Net;
+
+/**
+ * FileHeader - starts a weights file; the arrays of Net follow in
+ * declaration order, in native byte order like the bitbase file
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t hidden;
+    uint32_t l2;
+    uint32_t l3;
+} FileHeader;
+
+#define SECTION(field) {offsetof(Net, field), sizeof(((Net*)0)->field)}
+
+static const struct {
+    size_t offset;
+    size_t size;
+} Sections[] = {
+    SECTION(ftBias), SECTION(ftWeights), SECTION(l1Bias), SECTION(l1Weights),
+    SECTION(l2Bias), SECTION(l2Weights), SECTION(outBias), SECTION(outWeights),
+};
+
+#define SECTION_NB ((int)(sizeof(Sections) / sizeof(Sections[0])))
+
+/**
+ * Kernel - the inner loops of one instruction set. Every path computes
+ * in integers with the same wrap-around and rounding, so all of them
+ * give bit-identical scores.
+ *
+ * update: @out = @in + the @addCount rows in @add - the @subCount rows
+ *         in @sub, over NNUE_HIDDEN values
+ * clip: clamps @count accumulator values to [0, NNUE_RELU_MAX]
+ * affine: @out[o] = @bias[o] + the dot product of @in with row o of
+ *         @weights, for @outCount outputs; @inCount is a multiple of 32
+ */
+typedef struct {
+    void (*update)(int16_t* out, const int16_t* in, const int16_t* const* add, int addCount,
+                   const int16_t* const* sub, int subCount);
+    void (*clip)(uint8_t* out, const int16_t* in, int count);
+    void (*affine)(int32_t* out, const uint8_t* in, int inCount, const int8_t* weights, const int32_t* bias,
+                   int outCount);
+} Kernel;
+
+static Net* Network;
+static NnueSimd Simd = NNUE_SIMD_NB;    /** not chosen until a network is set up */
+
+static void updateScalar(int16_t* out, const int16_t* in, const int16_t* const* add, int addCount,
+                         const int16_t* const* sub, int subCount) {
+    for (int i = 0; i < NNUE_HIDDEN; ++i) {
+        int16_t value = in[i];
+
+        for (int j = 0; j < addCount; ++j) value = (int16_t)(value + add[j][i]);
+        for (int j = 0; j < subCount; ++j) value = (int16_t)(value - sub[j][i]);
+        out[i] = value;
+    }
+}
+
+static void clipScalar(uint8_t* out, const int16_t* in, int count) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = (uint8_t)(in[i] < 0 ? 0 : in[i] > NNUE_RELU_MAX ? NNUE_RELU_MAX : in[i]);
+    }
+}
+
+static void affineScalar(int32_t* out, const uint8_t* in, int inCount, const int8_t* weights, const int32_t* bias,
+                         int outCount) {
+    for (int o = 0; o < outCount; ++o) {
+        const int8_t* row = weights + (size_t)o * (size_t)inCount;
+        int32_t sum = bias[o];
+
+        for (int i = 0; i < inCount; ++i) sum += in[i] * row[i];
+        out[o] = sum;
+    }
+}
+
+#ifdef NNUE_X86
+
+/* The SIMD dot products multiply byte pairs with maddubs, which
+ * saturates at 16 bits; activations stop at 127, so a pair is at most
+ * 2 * 127 * 128 and the sums match the scalar ones exactly. */
+
+__attribute__((target("sse4.1")))
+static void updateSse41(int16_t* out, const int16_t* in, const int16_t* const* add, int addCount,
+                        const int16_t* const* sub, int subCount) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i value = _mm_loadu_si128((const __m128i*)(in + i));
+
+        for (int j = 0; j < addCount; ++j) value = _mm_add_epi16(value, _mm_loadu_si128((const __m128i*)(add[j] + i)));
+        for (int j = 0; j < subCount; ++j) value = _mm_sub_epi16(value, _mm_loadu_si128((const __m128i*)(sub[j] + i)));
+        _mm_storeu_si128((__m128i*)(out + i), value);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void clipSse41(uint8_t* out, const int16_t* in, int count) {
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int i = 0; i < count; i += 16) {
+        __m128i packed = _mm_packs_epi16(_mm_loadu_si128((const __m128i*)(in + i)),
+                                         _mm_loadu_si128((const __m128i*)(in + i + 8)));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_max_epi8(packed, zero));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void affineSse41(int32_t* out, const uint8_t* in, int inCount, const int8_t* weights, const int32_t* bias,
+                        int outCount) {
+    const __m128i ones = _mm_set1_epi16(1);
+
+    for (int o = 0; o < outCount; ++o) {
+        const int8_t* row = weights + (size_t)o * (size_t)inCount;
+        __m128i sum = _mm_setzero_si128();
+
+        for (int i = 0; i < inCount; i += 16) {
+            __m128i product = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(in + i)),
+                                                _mm_loadu_si128((const __m128i*)(row + i)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(product, ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        out[o] = bias[o] + _mm_cvtsi128_si32(sum);
+    }
+}
+
+__attribute__((target("avx2")))
+static void updateAvx2(int16_t* out, const int16_t* in, const int16_t* const* add, int addCount,
+                       const int16_t* const* sub, int subCount) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)(in + i));
+
+        for (int j = 0; j < addCount; ++j) {
+            value = _mm256_add_epi16(value, _mm256_loadu_si256((const __m256i*)(add[j] + i)));
+        }
+        for (int j = 0; j < subCount; ++j) {
+            value = _mm256_sub_epi16(value, _mm256_loadu_si256((const __m256i*)(sub[j] + i)));
+        }
+        _mm256_storeu_si256((__m256i*)(out + i), value);
+    }
+}
+
+__attribute__((target("avx2")))
+static void clipAvx2(uint8_t* out, const int16_t* in, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int i = 0; i < count; i += 32) {
+        __m256i packed = _mm256_packs_epi16(_mm256_loadu_si256((const __m256i*)(in + i)),
+                                            _mm256_loadu_si256((const __m256i*)(in + i + 16)));
+        /* packs works within each 128-bit lane; put the quarters back in order */
+        packed = _mm256_permute4x64_epi64(_mm256_max_epi8(packed, zero), 0xD8);
+        _mm256_storeu_si256((__m256i*)(out + i), packed);
+    }
+}
+
+__attribute__((target("avx2")))
+static void affineAvx2(int32_t* out, const uint8_t* in, int inCount, const int8_t* weights, const int32_t* bias,
+                       int outCount) {
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    for (int o = 0; o < outCount; ++o) {
+        const int8_t* row = weights + (size_t)o * (size_t)inCount;
+        __m256i sum = _mm256_setzero_si256();
+        __m128i half;
+
+        for (int i = 0; i < inCount; i += 32) {
+            __m256i product = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(in + i)),
+                                                   _mm256_loadu_si256((const __m256i*)(row + i)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, ones));
+        }
+        half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        out[o] = bias[o] + _mm_cvtsi128_si32(half);
+    }
+}
+
+static const Kernel Kernels[NNUE_SIMD_NB] = {
+    {updateScalar, clipScalar, affineScalar},
+    {updateSse41, clipSse41, affineSse41},
+    {updateAvx2, clipAvx2, affineAvx2},
+};
+
+#else
+
+static const Kernel Kernels[NNUE_SIMD_NB] = {
+    {updateScalar, clipScalar, affineScalar},
+};
+
+#endif
+
+bool nnueSimdSupported(NnueSimd simd) {
+    switch (simd) {
+    case NNUE_SCALAR:
+        return true;
+#ifdef NNUE_X86
+    case NNUE_SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case NNUE_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * nnueSetSimd - runs the network on @simd from now on; not while a
+ * search is evaluating with it
+ *
+ * Return: false if this machine lacks @simd (the path is then unchanged)
+ */
+bool nnueSetSimd(NnueSimd simd) {
+    if (!nnueSimdSupported(simd)) return false;
+    Simd = simd;
+    return true;
+}
+
+/**
+ * nnueGetSimd - the path in use: the fastest one this machine supports
+ * unless nnueSetSimd chose another
+ */
+NnueSimd nnueGetSimd(void) {
+    NnueSimd best = NNUE_SCALAR;
+
+    if (Simd != NNUE_SIMD_NB) return Simd;
+    for (int simd = NNUE_SCALAR; simd < NNUE_SIMD_NB; ++simd) {
+        if (nnueSimdSupported((NnueSimd)simd)) best = (NnueSimd)simd;
+    }
+    return best;
+}
+
+const char* nnueSimdName(NnueSimd simd) {
+    static const char* const Names[NNUE_SIMD_NB] = {"scalar", "sse4.1", "avx2"};
+    return (simd >= NNUE_SCALAR && simd < NNUE_SIMD_NB) ? Names[simd] : "unknown";
+}
+
+static Net* allocateNet(void) {
+    void* memory = NULL;
+    return posix_memalign(&memory, NNUE_ALIGNMENT, sizeof(Net)) == 0 ? memory : NULL;
+}
+
+/* Makes @net current; the path is fixed here so searching threads
+ * never race to choose it */
+static void install(Net* net) {
+    nnueFree();
+    Network = net;
+    Simd = nnueGetSimd();
+}
+
+/**
+ * nnueLoad - reads a weights file written by nnueSave (or a trainer
+ * producing the same layout) and makes it the evaluation network. The
+ * network in use, if any, stays until the new one has been read whole.
+ *
+ * Return: false if the file is missing, truncated, has extra data or
+ *         describes a network of another shape
+ */
+bool nnueLoad(const char* path) {
+    FILE* file = fopen(path, "rb");
+    FileHeader header;
+    Net* net = NULL;
+    bool ok;
+
+    if (!file) return false;
+    ok = fread(&header, sizeof(header), 1, file) == 1
+      && header.magic == NNUE_MAGIC && header.version == NNUE_VERSION
+      && header.inputs == NNUE_INPUTS && header.hidden == NNUE_HIDDEN
+      && header.l2 == NNUE_L2 && header.l3 == NNUE_L3
+      && (net = allocateNet()) != NULL;
+    for (int i = 0; i < SECTION_NB && ok; ++i) {
+        ok = fread((uint8_t*)net + Sections[i].offset, Sections[i].size, 1, file) == 1;
+    }
+    ok = ok && fgetc(file) == EOF;
+    fclose(file);
+
+    if (!ok) {
+        free(net);
+        return false;
+    }
+    install(net);
+    return true;
+}
+
+/**
+ * nnueSave - writes the network in use to @path
+ *
+ * Return: false without a network or if the file could not be written
+ */
+bool nnueSave(const char* path) {
+    FileHeader header = {NNUE_MAGIC, NNUE_VERSION, NNUE_INPUTS, NNUE_HIDDEN, NNUE_L2, NNUE_L3};
+    FILE* file;
+    bool ok;
+
+    if (!Network || !(file = fopen(path, "wb"))) return false;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < SECTION_NB && ok; ++i) {
+        ok = fwrite((const uint8_t*)Network + Sections[i].offset, Sections[i].size, 1, file) == 1;
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok) remove(path);
+    return ok;
+}
+
+static int randomIn(uint64_t* seed, int low, int high) {
+    return low + (int)(randomNext(seed) % (uint64_t)(high - low + 1));
+}
+
+/**
+ * nnueRandomize - installs an untrained network of small random weights
+ * drawn from @seed. It plays nonsense, but exercises and times every
+ * path exactly like a trained one.
+ *
+ * Return: false if the weights could not be allocated
+ */
+bool nnueRandomize(uint64_t seed) {
+    Net* net = allocateNet();
+
+    if (!net) return false;
+    seed = seed ? seed : 1;
+    for (int i = 0; i < NNUE_HIDDEN; ++i) net->ftBias[i] = (int16_t)randomIn(&seed, 0, 64);
+    for (int i = 0; i < NNUE_INPUTS; ++i) {
+        for (int j = 0; j < NNUE_HIDDEN; ++j) net->ftWeights[i][j] = (int16_t)randomIn(&seed, -24, 24);
+    }
+    for (int o = 0; o < NNUE_L2; ++o) {
+        net->l1Bias[o] = randomIn(&seed, -512, 512);
+        for (int i = 0; i < 2 * NNUE_HIDDEN; ++i) net->l1Weights[o][i] = (int8_t)randomIn(&seed, -8, 8);
+    }
+    for (int o = 0; o < NNUE_L3; ++o) {
+        net->l2Bias[o] = randomIn(&seed, -512, 512);
+        for (int i = 0; i < NNUE_L2; ++i) net->l2Weights[o][i] = (int8_t)randomIn(&seed, -32, 32);
+    }
+    net->outBias = 0;
+    for (int i = 0; i < NNUE_L3; ++i) net->outWeights[i] = (int8_t)randomIn(&seed, -64, 64);
+
+    install(net);
+    return true;
+}
+
+void nnueFree(void) {
+    free(Network);
+    Network = NULL;
+}
+
+bool nnueLoaded(void) {
+    return Network != NULL;
+}
+
+/**
+ * featureRow - the first-layer weights of @piece on @square as seen by
+ * @perspective: its own pieces come first, and black sees the board
+ * flipped, so both sides share one set of weights
+ */
+static inline const int16_t* featureRow(Piece piece, int square, int perspective) {
+    int side = PIECE_COLOR(piece) != (perspective == 0 ? WHITE : BLACK);
+
+    if (perspective == 1) square ^= 56;
+    return Network->ftWeights[(side * 6 + PIECE_TYPE(piece) - PAWN) * SQUARE_NB + square];
+}
+
+static void refresh(const Kernel* kernel, const Position* pos, NnueAccumulator* acc) {
+    const int16_t* rows[SQUARE_NB];
+
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        Bitboard occupied = positionOccupied(pos);
+        int count = 0;
+
+        while (occupied) {
+            int square = popLsb(&occupied);
+            rows[count++] = featureRow(pos->board[square], square, perspective);
+        }
+        kernel->update(acc->values[perspective], Network->ftBias, rows, count, NULL, 0);
+    }
+    acc->computed = true;
+}
+
+/* Brings @acc up to date from the computed entry just below it */
+static void applyDirty(const Kernel* kernel, NnueAccumulator* acc) {
+    const NnueAccumulator* previous = acc - 1;
+    const int16_t* add[NNUE_DIRTY_MAX];
+    const int16_t* sub[NNUE_DIRTY_MAX];
+
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        int addCount = 0, subCount = 0;
+
+        for (int i = 0; i < acc->dirtyCount; ++i) {
+            if (acc->dirtyFrom[i] != SQUARE_NONE) sub[subCount++] = featureRow(acc->dirtyPiece[i], acc->dirtyFrom[i], perspective);
+            if (acc->dirtyTo[i] != SQUARE_NONE) add[addCount++] = featureRow(acc->dirtyPiece[i], acc->dirtyTo[i], perspective);
+        }
+        kernel->update(acc->values[perspective], previous->values[perspective], add, addCount, sub, subCount);
+    }
+    acc->computed = true;
+}
+
+static void activate(uint8_t* out, const int32_t* in, int count) {
+    for (int i = 0; i < count; ++i) {
+        int32_t value = in[i] >> NNUE_WEIGHT_SHIFT;
+        out[i] = (uint8_t)(value < 0 ? 0 : value > NNUE_RELU_MAX ? NNUE_RELU_MAX : value);
+    }
+}
+
+static int32_t forward(const Kernel* kernel, const int16_t* us, const int16_t* them) {
+    uint8_t input[2 * NNUE_HIDDEN] __attribute__((aligned(NNUE_ALIGNMENT)));
+    uint8_t hidden1[NNUE_L2] __attribute__((aligned(NNUE_ALIGNMENT)));
+    uint8_t hidden2[NNUE_L3] __attribute__((aligned(NNUE_ALIGNMENT)));
+    int32_t sums[NNUE_L2 > NNUE_L3 ? NNUE_L2 : NNUE_L3];
+    int32_t output;
+
+    kernel->clip(input, us, NNUE_HIDDEN);
+    kernel->clip(input + NNUE_HIDDEN, them, NNUE_HIDDEN);
+    kernel->affine(sums, input, 2 * NNUE_HIDDEN, Network->l1Weights[0], Network->l1Bias, NNUE_L2);
+    activate(hidden1, sums, NNUE_L2);
+    kernel->affine(sums, hidden1, NNUE_L2, Network->l2Weights[0], Network->l2Bias, NNUE_L3);
+    activate(hidden2, sums, NNUE_L3);
+    kernel->affine(&output, hidden2, NNUE_L3, Network->outWeights, &Network->outBias, 1);
+    return output;
+}
+
+/**
+ * nnueEvaluate - network score of @pos in centipawns from the point of
+ * view of the side to move. pos->nnue must be set and a network loaded.
+ * The accumulator is updated from the nearest computed entry below it
+ * on the stack, or computed from the board when there is none.
+ */
+int nnueEvaluate(const Position* pos) {
+    const Kernel* kernel = &Kernels[Simd];
+    NnueAccumulator* acc = pos->nnue;
+    NnueAccumulator* entry = acc;
+    int us = pos->sideToMove == WHITE ? 0 : 1;
+    int value;
+
+    while (!entry->computed && entry->dirtyCount >= 0) entry--;
+    if (!entry->computed) {
+        refresh(kernel, pos, acc);
+    } else {
+        while (entry != acc) applyDirty(kernel, ++entry);
+    }
+
+    value = forward(kernel, acc->values[us], acc->values[us ^ 1]) / NNUE_OUTPUT_SCALE;
+    return value < -NNUE_EVAL_MAX ? -NNUE_EVAL_MAX : value > NNUE_EVAL_MAX ? NNUE_EVAL_MAX : value;
+}
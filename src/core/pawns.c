@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pawns.h"
+#include "eval.h"
+
+static const Score Doubled = MAKE_SCORE(-10, -20);
+static const Score Isolated = MAKE_SCORE(-10, -15);
+static const Score Backward = MAKE_SCORE(-8, -10);
+static const int PassedMg[BOARD_SIZE] = {0, 5, 10, 15, 25, 40, 60, 0};
+static const int PassedEg[BOARD_SIZE] = {0, 10, 20, 35, 60, 100, 150, 0};
+static const int ShieldBonus[3] = {0, 12, 6};
+
+static Bitboard FileBB[BOARD_SIZE];
+static Bitboard AdjacentFilesBB[BOARD_SIZE];
+static Bitboard ForwardFileBB[3][SQUARE_NB];    /** squares ahead on the same file */
+static Bitboard PassedSpanBB[3][SQUARE_NB];     /** same and adjacent files ahead */
+static Bitboard SupportSpanBB[3][SQUARE_NB];    /** adjacent files, same rank and behind */
+
+/**
+ * pawnsInit - builds the file and span masks; called from chessCoreInit
+ */
+void pawnsInit(void) {
+    for (int col = 0; col < BOARD_SIZE; ++col) {
+        FileBB[col] = COL_A_BB << col;
+    }
+    for (int col = 0; col < BOARD_SIZE; ++col) {
+        AdjacentFilesBB[col] = (col > 0 ? FileBB[col - 1] : 0) | (col < BOARD_SIZE - 1 ? FileBB[col + 1] : 0);
+    }
+    for (int square = 0; square < SQUARE_NB; ++square) {
+        int row = ROW_OF(square), col = COL_OF(square);
+        Bitboard above = (row < BOARD_SIZE - 1) ? ~(Bitboard)0 << (8 * (row + 1)) : 0;
+        Bitboard below = (row > 0) ? ~(Bitboard)0 >> (8 * (BOARD_SIZE - row)) : 0;
+        Bitboard thisRow = (Bitboard)0xFF << (8 * row);
+
+        ForwardFileBB[WHITE][square] = FileBB[col] & above;
+        ForwardFileBB[BLACK][square] = FileBB[col] & below;
+        PassedSpanBB[WHITE][square] = (FileBB[col] | AdjacentFilesBB[col]) & above;
+        PassedSpanBB[BLACK][square] = (FileBB[col] | AdjacentFilesBB[col]) & below;
+        SupportSpanBB[WHITE][square] = AdjacentFilesBB[col] & (below | thisRow);
+        SupportSpanBB[BLACK][square] = AdjacentFilesBB[col] & (above | thisRow);
+    }
+}
+
+/**
+ * pawnTableResize - (re)allocates @table to the largest power-of-two
+ * entry count that fits in @sizeKb and clears it; 0 disables the cache
+ *
+ * Return: false if the allocation failed (the table is then disabled)
+ */
+bool pawnTableResize(PawnTable* table, size_t sizeKb) {
+    size_t count = 1;
+
+    pawnTableFree(table);
+    if (sizeKb * 1024 < sizeof(PawnEntry)) return true;
+
+    while (count * 2 * sizeof(PawnEntry) <= sizeKb * 1024) count *= 2;
+    table->entries = malloc(count * sizeof(PawnEntry));
+    if (!table->entries) return false;
+    table->mask = count - 1;
+    pawnTableClear(table);
+    return true;
+}
+
+void pawnTableFree(PawnTable* table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+    table->probes = table->hits = 0;
+}
+
+/**
+ * pawnTableClear - empties the table and its counters. A cleared entry
+ * has key 0 and score 0, which is the right answer for the one pawn
+ * skeleton hashing to 0 (no pawns at all); its shelters are marked
+ * stale so they are recomputed.
+ */
+void pawnTableClear(PawnTable* table) {
+    if (!table->entries) return;
+
+    memset(table->entries, 0, (table->mask + 1) * sizeof(PawnEntry));
+    for (size_t i = 0; i <= table->mask; ++i) {
+        table->entries[i].kingSquare[WHITE] = table->entries[i].kingSquare[BLACK] = SQUARE_NONE;
+    }
+    table->probes = table->hits = 0;
+}
+
+/**
+ * evaluatePawns - doubled, isolated, backward and passed pawns of @us
+ */
+static Score evaluatePawns(const Position* pos, PieceColor us) {
+    PieceColor them = OPPONENT(us);
+    Bitboard ours = positionPieces(pos, us, PAWN);
+    Bitboard theirs = positionPieces(pos, them, PAWN);
+    Bitboard pawns = ours;
+    Score score = 0;
+
+    while (pawns) {
+        int square = popLsb(&pawns);
+        int col = COL_OF(square);
+        int relativeRow = (us == WHITE) ? ROW_OF(square) : BOARD_SIZE - 1 - ROW_OF(square);
+        int stop = (us == WHITE) ? square + 8 : square - 8;
+
+        if (ForwardFileBB[us][square] & ours) score += Doubled;
+        if (!(AdjacentFilesBB[col] & ours)) {
+            score += Isolated;
+        } else if (!(SupportSpanBB[us][square] & ours) && (PawnAttacks[us][stop] & theirs)) {
+            score += Backward;
+        }
+        if (!(PassedSpanBB[us][square] & theirs) && !(ForwardFileBB[us][square] & ours)) {
+            score += MAKE_SCORE(PassedMg[relativeRow], PassedEg[relativeRow]);
+        }
+    }
+    return score;
+}
+
+/**
+ * pawnProbe - the structure entry for the pawns of @pos, computed and
+ * stored on a miss. Without a table the entry is computed into @scratch.
+ *
+ * Return: the entry; valid until the next probe of the same table
+ */
+PawnEntry* pawnProbe(PawnTable* table, const Position* pos, PawnEntry* scratch) {
+    PawnEntry* entry = scratch;
+
+    if (table && table->entries) {
+        entry = &table->entries[pos->pawnKey & table->mask];
+        table->probes++;
+        if (entry->key == pos->pawnKey) {
+            table->hits++;
+            return entry;
+        }
+    }
+
+    entry->key = pos->pawnKey;
+    entry->score = evaluatePawns(pos, WHITE) - evaluatePawns(pos, BLACK);
+    entry->kingSquare[WHITE] = entry->kingSquare[BLACK] = SQUARE_NONE;
+    return entry;
+}
+
+/**
+ * pawnShelter - own pawns on the king's file and its neighbours, one
+ * and two rows in front; midgame only. Cached in @entry for the king
+ * square it was last asked about.
+ */
+Score pawnShelter(PawnEntry* entry, const Position* pos, PieceColor us) {
+    int king = pos->kingSquare[us];
+    int col = COL_OF(king);
+    Bitboard pawns;
+    int bonus = 0;
+
+    if (entry->kingSquare[us] == king) return entry->shelter[us];
+
+    pawns = positionPieces(pos, us, PAWN) & (FileBB[col] | AdjacentFilesBB[col]);
+    for (int step = 1; step <= 2; ++step) {
+        int row = ROW_OF(king) + ((us == WHITE) ? step : -step);
+        if (row < 0 || row >= BOARD_SIZE) break;
+        bonus += ShieldBonus[step] * popCount(pawns & ((Bitboard)0xFF << (8 * row)));
+    }
+    entry->kingSquare[us] = (uint8_t)king;
+    entry->shelter[us] = MAKE_SCORE(bonus, 0);
+    return entry->shelter[us];
+}
@@ -0,0 +1,569 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgn.h"
+#include "movegen.h"
+
+#define PGN_LINE_WIDTH 79
+
+static const char PieceLetters[] = " PNBRQK";
+
+/* The Seven Tag Roster, written first and in this order */
+static const char* const RosterTags[] = {"Event", "Site", "Date", "Round", "White", "Black", "Result"};
+static const char* const RosterDefaults[] = {"?", "?", "????.??.??", "?", "?", "?", "*"};
+
+#define ROSTER_SIZE ((int)(sizeof(RosterTags) / sizeof(RosterTags[0])))
+
+/**
+ * moveToSan - writes @move, legal in @pos, in standard algebraic
+ * notation ("Nbd2", "exd5", "e8=Q+", "O-O#") to @buffer, which must
+ * hold SAN_MAX bytes. A piece move names its origin file, else rank,
+ * else both, only when another piece of its kind could also go there.
+ *
+ * Return: @buffer
+ */
+char* moveToSan(const Position* pos, Move move, char* buffer) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    PieceType type = PIECE_TYPE(pos->board[from]);
+    char* out = buffer;
+    Position after = *pos;
+    UndoInfo undo;
+    MoveList list;
+
+    if (MOVE_TYPE(move) == MOVE_CASTLING) {
+        strcpy(out, (to > from) ? "O-O" : "O-O-O");
+        out += strlen(out);
+    } else {
+        if (type == PAWN) {
+            if (positionIsCapture(pos, move)) *out++ = (char)('a' + COL_OF(from));
+        } else {
+            bool ambiguous = false, sameCol = false, sameRow = false;
+
+            *out++ = PieceLetters[type];
+            generateLegalMoves(pos, &list);
+            for (int i = 0; i < list.count; ++i) {
+                int other = MOVE_FROM(list.moves[i]);
+
+                if (other == from || MOVE_TO(list.moves[i]) != to || pos->board[other] != pos->board[from]) continue;
+                ambiguous = true;
+                sameCol |= COL_OF(other) == COL_OF(from);
+                sameRow |= ROW_OF(other) == ROW_OF(from);
+            }
+            if (ambiguous && (!sameCol || sameRow)) *out++ = (char)('a' + COL_OF(from));
+            if (ambiguous && sameCol) *out++ = (char)('1' + ROW_OF(from));
+        }
+        if (positionIsCapture(pos, move)) *out++ = 'x';
+        *out++ = (char)('a' + COL_OF(to));
+        *out++ = (char)('1' + ROW_OF(to));
+        if (MOVE_TYPE(move) == MOVE_PROMOTION) {
+            *out++ = '=';
+            *out++ = PieceLetters[MOVE_PROMOTED(move)];
+        }
+    }
+
+    /* The copy must not update the caller's network accumulators */
+    after.nnue = NULL;
+    positionMakeMove(&after, move, &undo);
+    if (positionInCheck(&after, after.sideToMove)) {
+        *out++ = generateLegalMoves(&after, &list) ? '+' : '#';
+    }
+    *out = '\0';
+    return buffer;
+}
+
+static PieceType pieceFromLetter(char letter) {
+    const char* found = letter ? strchr(PieceLetters + 1, letter) : NULL;
+    return found ? (PieceType)(found - PieceLetters) : EMPTY;
+}
+
+/* Squares a piece of @type could move to @to from, ignoring pins */
+static Bitboard originsOf(const Position* pos, PieceType type, int to) {
+    PieceColor us = pos->sideToMove;
+    Bitboard occupied = positionOccupied(pos);
+    Bitboard pawns = positionPieces(pos, us, PAWN), origins = 0;
+    int behind = (us == WHITE) ? to - 8 : to + 8;
+
+    switch (type) {
+    case PAWN:
+        if ((pos->board[to] != EMPTY && PIECE_COLOR(pos->board[to]) != us) || to == pos->epSquare) {
+            return PawnAttacks[OPPONENT(us)][to] & pawns;
+        }
+        if (pos->board[to] != EMPTY || behind < 0 || behind >= SQUARE_NB) return 0;
+        if (pos->board[behind] == EMPTY && ROW_OF(to) == ((us == WHITE) ? 3 : 4)) {
+            behind = (us == WHITE) ? behind - 8 : behind + 8;
+        }
+        return pawns & SQUARE_BB(behind);
+    case KNIGHT: origins = KnightAttacks[to]; break;
+    case BISHOP: origins = bishopAttacks(to, occupied); break;
+    case ROOK: origins = rookAttacks(to, occupied); break;
+    case QUEEN: origins = queenAttacks(to, occupied); break;
+    case KING: origins = KingAttacks[to]; break;
+    default: return 0;
+    }
+    return origins & positionPieces(pos, us, type);
+}
+
+/**
+ * moveFromSan - the legal move of @pos written as @san. Check and
+ * annotation suffixes, "-" and "=" are optional, as is "x" except on
+ * pawn captures, castling may be written with zeros, and over-specified
+ * origins are accepted; a promotion must name its piece. Only the
+ * pieces that could reach the target square are tried, not every move,
+ * as this is the inner loop of reading a PGN database.
+ *
+ * Return: the move, MOVE_NONE if @san is malformed, illegal here or
+ * matches more than one move
+ */
+Move moveFromSan(const Position* pos, const char* san) {
+    char text[SAN_MAX];
+    size_t length = 0;
+    PieceType type = PAWN, promoted = EMPTY;
+    int fromCol = -1, fromRow = -1, to;
+    Move found = MOVE_NONE;
+    bool capture = false;
+    Bitboard origins;
+
+    /* Keep the squares and letters, drop the decoration */
+    for (const char* c = san; *c && *c != '+' && *c != '#' && *c != '!' && *c != '?'; ++c) {
+        if (*c == 'x' || *c == ':') capture = true;
+        if (*c == 'x' || *c == '-' || *c == '=' || *c == ':') continue;
+        if (length == sizeof(text) - 1) return MOVE_NONE;
+        text[length++] = *c;
+    }
+    text[length] = '\0';
+
+    if (strcmp(text, "OO") == 0 || strcmp(text, "00") == 0 || strcmp(text, "OOO") == 0 || strcmp(text, "000") == 0) {
+        int col = (length == 2) ? 6 : 2;
+        MoveList list;
+
+        generateLegalMoves(pos, &list);
+        for (int i = 0; i < list.count; ++i) {
+            if (MOVE_TYPE(list.moves[i]) == MOVE_CASTLING && COL_OF(MOVE_TO(list.moves[i])) == col) return list.moves[i];
+        }
+        return MOVE_NONE;
+    }
+
+    if (length > 0 && isupper((unsigned char)text[0])) {
+        if ((type = pieceFromLetter(text[0])) == EMPTY) return MOVE_NONE;
+        memmove(text, text + 1, length--);
+    }
+    if (length > 2 && (promoted = pieceFromLetter((char)toupper((unsigned char)text[length - 1]))) != EMPTY) {
+        if (type != PAWN || promoted == PAWN || promoted == KING) return MOVE_NONE;
+        text[--length] = '\0';
+    }
+    if (length < 2 || length > 4) return MOVE_NONE;
+    if (text[length - 2] < 'a' || text[length - 2] > 'h' || text[length - 1] < '1' || text[length - 1] > '8') {
+        return MOVE_NONE;
+    }
+    to = SQUARE(text[length - 1] - '1', text[length - 2] - 'a');
+    for (size_t i = 0; i + 2 < length; ++i) {
+        if (text[i] >= 'a' && text[i] <= 'h') fromCol = text[i] - 'a';
+        else if (text[i] >= '1' && text[i] <= '8') fromRow = text[i] - '1';
+        else return MOVE_NONE;
+    }
+    if (pos->board[to] != EMPTY && PIECE_COLOR(pos->board[to]) == pos->sideToMove) return MOVE_NONE;
+    /* A bare pawn push cannot take: "d5" onto a piece is not exd5 */
+    if (type == PAWN && !capture && (pos->board[to] != EMPTY || to == pos->epSquare)) return MOVE_NONE;
+    if ((type == PAWN && (ROW_OF(to) == 0 || ROW_OF(to) == 7)) != (promoted != EMPTY)) return MOVE_NONE;
+
+    origins = originsOf(pos, type, to);
+    while (origins) {
+        int from = popLsb(&origins);
+        Position after = *pos;
+        UndoInfo undo;
+        Move move;
+
+        if ((fromCol >= 0 && COL_OF(from) != fromCol) || (fromRow >= 0 && ROW_OF(from) != fromRow)) continue;
+        if (promoted != EMPTY) move = MAKE_PROMOTION(from, to, promoted);
+        else if (type == PAWN && to == pos->epSquare) move = MAKE_SPECIAL(from, to, MOVE_EN_PASSANT);
+        else move = MAKE_MOVE(from, to);
+
+        /* Pins and checks: the move is legal if it leaves no check. The
+         * copy must not update the caller's network accumulators */
+        after.nnue = NULL;
+        positionMakeMove(&after, move, &undo);
+        if (positionInCheck(&after, pos->sideToMove)) continue;
+        if (found != MOVE_NONE) return MOVE_NONE;
+        found = move;
+    }
+    return found;
+}
+
+void pgnGameInit(PgnGame* game) {
+    memset(game, 0, sizeof(*game));
+    positionSetStart(&game->start);
+    strcpy(game->result, "*");
+}
+
+void pgnGameFree(PgnGame* game) {
+    free(game->moves);
+    pgnGameInit(game);
+}
+
+/**
+ * pgnGameReset - empties @game for reuse, keeping its move array, and
+ * starts it from @start (the standard position if NULL)
+ */
+void pgnGameReset(PgnGame* game, const Position* start) {
+    game->tagCount = 0;
+    game->moveCount = 0;
+    game->line = 0;
+    game->error[0] = '\0';
+    strcpy(game->result, "*");
+    if (start) {
+        game->start = *start;
+        game->start.history = NULL;
+        game->start.nnue = NULL;
+    } else {
+        positionSetStart(&game->start);
+    }
+}
+
+bool pgnGameAddMove(PgnGame* game, Move move) {
+    if (game->moveCount == game->moveCapacity) {
+        int capacity = game->moveCapacity ? game->moveCapacity * 2 : 256;
+        Move* moves = realloc(game->moves, (size_t)capacity * sizeof(Move));
+
+        if (!moves) return false;
+        game->moves = moves;
+        game->moveCapacity = capacity;
+    }
+    game->moves[game->moveCount++] = move;
+    return true;
+}
+
+/**
+ * pgnGetTag - the value of tag @name, NULL if the game has none
+ */
+const char* pgnGetTag(const PgnGame* game, const char* name) {
+    for (int i = 0; i < game->tagCount; ++i) {
+        if (strcmp(game->tags[i].name, name) == 0) return game->tags[i].value;
+    }
+    return NULL;
+}
+
+/**
+ * pgnSetTag - sets or adds tag @name; names and values too long for a
+ * PgnTag are cut short, tags beyond PGN_TAGS_MAX are dropped
+ */
+void pgnSetTag(PgnGame* game, const char* name, const char* value) {
+    PgnTag* tag = NULL;
+
+    for (int i = 0; i < game->tagCount && !tag; ++i) {
+        if (strcmp(game->tags[i].name, name) == 0) tag = &game->tags[i];
+    }
+    if (!tag) {
+        if (game->tagCount == PGN_TAGS_MAX) return;
+        tag = &game->tags[game->tagCount++];
+        snprintf(tag->name, sizeof(tag->name), "%s", name);
+    }
+    snprintf(tag->value, sizeof(tag->value), "%s", value);
+}
+
+/**
+ * pgnReaderOpen - prepares to read games from @file, which stays owned
+ * by the caller
+ *
+ * Return: false if the buffer could not be allocated
+ */
+bool pgnReaderOpen(PgnReader* reader, FILE* file) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    reader->capacity = PGN_READ_BUFFER;
+    reader->buffer = malloc(reader->capacity);
+    return reader->buffer != NULL;
+}
+
+void pgnReaderClose(PgnReader* reader) {
+    free(reader->buffer);
+    memset(reader, 0, sizeof(*reader));
+}
+
+/**
+ * nextLine - the next input line, without its line ending, in
+ * reader->line; valid until the following call. A line pushed back
+ * with reader->pending is returned again.
+ *
+ * Return: false at the end of the input (or on a read error)
+ */
+static bool nextLine(PgnReader* reader) {
+    char* newline;
+
+    if (reader->pending) {
+        reader->pending = false;
+        return true;
+    }
+    while (!(newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start))) {
+        size_t kept = reader->end - reader->start;
+
+        if (reader->eof) {
+            if (kept == 0) return false;
+            newline = reader->buffer + reader->end;
+            break;
+        }
+        /* Slide the partial line to the front; grow only for a line
+         * longer than the whole buffer */
+        memmove(reader->buffer, reader->buffer + reader->start, kept);
+        reader->start = 0;
+        reader->end = kept;
+        if (kept + 1 >= reader->capacity) {
+            char* grown = realloc(reader->buffer, reader->capacity * 2);
+
+            if (!grown) return false;
+            reader->buffer = grown;
+            reader->capacity *= 2;
+        }
+        reader->end += fread(reader->buffer + kept, 1, reader->capacity - kept - 1, reader->file);
+        if (reader->end == kept) reader->eof = true;
+    }
+
+    reader->line = reader->buffer + reader->start;
+    reader->bytes += (size_t)(newline - reader->line) + (newline < reader->buffer + reader->end);
+    reader->start = (size_t)(newline - reader->buffer) + (newline < reader->buffer + reader->end);
+    *newline = '\0';
+    if (newline > reader->line && newline[-1] == '\r') newline[-1] = '\0';
+    reader->lineNumber++;
+    return true;
+}
+
+/* [Name "Value"], with \" and \\ escapes in the value */
+static void parseTag(PgnGame* game, const char* line) {
+    char name[PGN_TAG_NAME_MAX], value[PGN_TAG_VALUE_MAX];
+    size_t length = 0;
+
+    while (*line == '[' || isspace((unsigned char)*line)) line++;
+    while (*line && !isspace((unsigned char)*line) && *line != '"' && length < sizeof(name) - 1) name[length++] = *line++;
+    name[length] = '\0';
+    if (!(line = strchr(line, '"')) || length == 0) return;
+
+    length = 0;
+    for (++line; *line && *line != '"'; ++line) {
+        if (*line == '\\' && line[1]) line++;
+        if (length < sizeof(value) - 1) value[length++] = *line;
+    }
+    value[length] = '\0';
+    pgnSetTag(game, name, value);
+}
+
+static bool isResult(const char* token) {
+    return strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0
+        || strcmp(token, "*") == 0;
+}
+
+/**
+ * MoveText - where the movetext scanner stands between lines of a game
+ */
+typedef struct {
+    Position pos;
+    bool started;
+    bool inComment;
+    int variationDepth;
+} MoveText;
+
+static void playToken(PgnReader* reader, PgnGame* game, MoveText* text, char* token) {
+    UndoInfo undo;
+    Move move;
+
+    /* Move numbers, "12." and "12...", may be glued to the move */
+    if (isdigit((unsigned char)*token)) {
+        char* c = token;
+
+        while (isdigit((unsigned char)*c)) c++;
+        if (*c != '.') return;
+        while (*c == '.') c++;
+        if (!*(token = c)) return;
+    }
+    if (*token == '$' || game->error[0]) return;
+
+    if ((move = moveFromSan(&text->pos, token)) == MOVE_NONE) {
+        snprintf(game->error, sizeof(game->error), "line %llu: illegal move %s at ply %d",
+                 (unsigned long long)reader->lineNumber, token, game->moveCount + 1);
+        return;
+    }
+    if (!pgnGameAddMove(game, move)) {
+        snprintf(game->error, sizeof(game->error), "out of memory at ply %d", game->moveCount + 1);
+        return;
+    }
+    positionMakeMove(&text->pos, move, &undo);
+    text->pos.history = NULL;
+}
+
+/**
+ * scanMoveText - feeds one line of movetext to the game
+ *
+ * Return: true once the game's result has been read
+ */
+static bool scanMoveText(PgnReader* reader, PgnGame* game, MoveText* text, char* line) {
+    char* c = line;
+
+    if (*line == '%') return false;
+    while (*c) {
+        char* token;
+
+        if (text->inComment) {
+            if (!(c = strchr(c, '}'))) return false;
+            text->inComment = false;
+            c++;
+            continue;
+        }
+        switch (*c) {
+        case '{':
+            text->inComment = true;
+            c++;
+            continue;
+        case ';':
+            return false;
+        case '(':
+            text->variationDepth++;
+            c++;
+            continue;
+        case ')':
+            if (text->variationDepth > 0) text->variationDepth--;
+            c++;
+            continue;
+        default:
+            break;
+        }
+        if (isspace((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+
+        token = c;
+        while (*c && !isspace((unsigned char)*c) && !strchr("{}();", *c)) c++;
+        if (text->variationDepth > 0) continue;
+
+        {
+            char saved = *c;
+
+            *c = '\0';
+            if (isResult(token)) {
+                snprintf(game->result, sizeof(game->result), "%s", token);
+                return true;
+            }
+            playToken(reader, game, text, token);
+            *c = saved;
+        }
+    }
+    return false;
+}
+
+/**
+ * pgnRead - reads the next game into @game, replaying every move
+ * through the rules to turn SAN into moves; a game with an illegal move
+ * is still read to its end and returned with game->error set. A game
+ * without a result ends where the next one's tags begin.
+ *
+ * Return: false when no game is left
+ */
+bool pgnRead(PgnReader* reader, PgnGame* game) {
+    MoveText text = {0};
+    bool found = false;
+
+    pgnGameReset(game, NULL);
+    while (nextLine(reader)) {
+        char* line = reader->line;
+
+        while (isspace((unsigned char)*line)) line++;
+        if (!text.inComment && *line == '[') {
+            if (text.started) {
+                reader->pending = true;
+                break;
+            }
+            if (!found) game->line = reader->lineNumber;
+            found = true;
+            parseTag(game, line);
+            continue;
+        }
+        if (!text.started) {
+            const char* fen = pgnGetTag(game, "FEN");
+
+            if (*line == '\0' || *line == '%') continue;
+            if (!found) game->line = reader->lineNumber;
+            found = text.started = true;
+            if (fen && !positionSetFen(&game->start, fen)) {
+                positionSetStart(&game->start);
+                snprintf(game->error, sizeof(game->error), "line %llu: invalid FEN %s",
+                         (unsigned long long)game->line, fen);
+            }
+            text.pos = game->start;
+        }
+        if (scanMoveText(reader, game, &text, line)) break;
+    }
+    game->end = text.started ? text.pos : game->start;
+    return found;
+}
+
+static void writeTag(FILE* out, const char* name, const char* value) {
+    fprintf(out, "[%s \"", name);
+    for (const char* c = value; *c; ++c) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        fputc(*c, out);
+    }
+    fputs("\"]\n", out);
+}
+
+/* Appends one movetext token, breaking the line before PGN_LINE_WIDTH */
+static void writeToken(FILE* out, const char* token, int* column) {
+    int length = (int)strlen(token);
+
+    if (*column > 0 && *column + 1 + length > PGN_LINE_WIDTH) {
+        fputc('\n', out);
+        *column = 0;
+    }
+    if (*column > 0) {
+        fputc(' ', out);
+        (*column)++;
+    }
+    fputs(token, out);
+    *column += length;
+}
+
+/**
+ * pgnWrite - writes @game in export format: the Seven Tag Roster (with
+ * "?" for missing values), SetUp and FEN when the game does not start
+ * from the standard position, the other tags, then the main line in SAN
+ */
+void pgnWrite(FILE* out, const PgnGame* game) {
+    Position pos = game->start, standard;
+    char fen[FEN_MAX], standardFen[FEN_MAX], token[SAN_MAX + 16];
+    int column = 0;
+    UndoInfo undo;
+
+    positionSetStart(&standard);
+    for (int i = 0; i < ROSTER_SIZE; ++i) {
+        const char* value = (i == ROSTER_SIZE - 1) ? game->result : pgnGetTag(game, RosterTags[i]);
+        writeTag(out, RosterTags[i], value ? value : RosterDefaults[i]);
+    }
+    if (strcmp(positionToFen(&pos, fen), positionToFen(&standard, standardFen)) != 0) {
+        writeTag(out, "SetUp", "1");
+        writeTag(out, "FEN", fen);
+    }
+    for (int i = 0; i < game->tagCount; ++i) {
+        const char* name = game->tags[i].name;
+        bool skip = strcmp(name, "SetUp") == 0 || strcmp(name, "FEN") == 0;
+
+        for (int j = 0; j < ROSTER_SIZE && !skip; ++j) {
+            skip = strcmp(name, RosterTags[j]) == 0;
+        }
+        if (!skip) writeTag(out, name, game->tags[i].value);
+    }
+    fputc('\n', out);
+
+    pos.history = NULL;
+    for (int i = 0; i < game->moveCount; ++i) {
+        char san[SAN_MAX];
+
+        if (pos.sideToMove == WHITE || i == 0) {
+            snprintf(token, sizeof(token), "%u%s %s", (unsigned)pos.fullmoveNumber,
+                     pos.sideToMove == WHITE ? "." : "...", moveToSan(&pos, game->moves[i], san));
+        } else {
+            moveToSan(&pos, game->moves[i], token);
+        }
+        writeToken(out, token, &column);
+        positionMakeMove(&pos, game->moves[i], &undo);
+        pos.history = NULL;
+    }
+    writeToken(out, game->result, &column);
+    fputs("\n\n", out);
+}
@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <string.h>
+#include "position.h"
+#include "eval.h"
+#include "misc.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "pawns.h"
+#include "stats.h"
+
+uint64_t ZobristPiece[PIECE_NB][SQUARE_NB];
+uint64_t ZobristSide;
+uint64_t ZobristCastling[ALL_CASTLING + 1];
+uint64_t ZobristEnPassant[BOARD_SIZE];
+
+/* FEN letter of each Piece value, indexed by (color << 3) | type */
+static const char PieceChars[] = "         PNBRQK  pnbrqk";
+
+/* Rights lost when a move starts or ends on the square */
+static const uint8_t CastlingMask[SQUARE_NB] = {
+    [SQUARE(0, 0)] = WHITE_OOO, [SQUARE(0, 4)] = WHITE_OO | WHITE_OOO, [SQUARE(0, 7)] = WHITE_OO,
+    [SQUARE(7, 0)] = BLACK_OOO, [SQUARE(7, 4)] = BLACK_OO | BLACK_OOO, [SQUARE(7, 7)] = BLACK_OO,
+};
+
+/**
+ * chessCoreInit - builds the attack and hashing tables; call once at
+ * startup, before any position is set up or any thread is started
+ */
+void chessCoreInit(void) {
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+
+    bitboardInit();
+    evalInit();
+    pawnsInit();
+    statsAttach();
+    for (int piece = 0; piece < PIECE_NB; ++piece) {
+        for (int square = 0; square < SQUARE_NB; ++square) {
+            ZobristPiece[piece][square] = (PIECE_TYPE(piece) != EMPTY) ? randomNext(&seed) : 0;
+        }
+    }
+    ZobristSide = randomNext(&seed);
+
+    /* One key per right, so any mask hashes as the XOR of its rights */
+    for (int rights = 1; rights <= ALL_CASTLING; ++rights) {
+        int lowest = rights & -rights;
+        ZobristCastling[rights] = (rights == lowest) ? randomNext(&seed)
+                                                     : ZobristCastling[lowest] ^ ZobristCastling[rights ^ lowest];
+    }
+    for (int col = 0; col < BOARD_SIZE; ++col) {
+        ZobristEnPassant[col] = randomNext(&seed);
+    }
+}
+
+void positionClear(Position* pos) {
+    memset(pos, 0, sizeof(*pos));
+    pos->sideToMove = WHITE;
+    pos->epSquare = SQUARE_NONE;
+    pos->fullmoveNumber = 1;
+}
+
+/* Board edits without hashing; make/unmake hash the move as a whole.
+ * The piece-square score is cheap enough to follow every edit. */
+static inline void setPiece(Position* pos, int square, Piece piece) {
+    pos->board[square] = piece;
+    pos->byType[PIECE_TYPE(piece)] |= SQUARE_BB(square);
+    pos->byColor[PIECE_COLOR(piece)] |= SQUARE_BB(square);
+    pos->pieceCount[piece]++;
+    pos->psq += PieceSquare[piece][square];
+}
+
+static inline void clearPiece(Position* pos, int square) {
+    Piece piece = pos->board[square];
+
+    pos->board[square] = EMPTY;
+    pos->byType[PIECE_TYPE(piece)] &= ~SQUARE_BB(square);
+    pos->byColor[PIECE_COLOR(piece)] &= ~SQUARE_BB(square);
+    pos->pieceCount[piece]--;
+    pos->psq -= PieceSquare[piece][square];
+}
+
+static inline void shiftPiece(Position* pos, int from, int to) {
+    Piece piece = pos->board[from];
+    Bitboard fromTo = SQUARE_BB(from) | SQUARE_BB(to);
+
+    pos->board[from] = EMPTY;
+    pos->board[to] = piece;
+    pos->byType[PIECE_TYPE(piece)] ^= fromTo;
+    pos->byColor[PIECE_COLOR(piece)] ^= fromTo;
+    pos->psq += PieceSquare[piece][to] - PieceSquare[piece][from];
+    if (PIECE_TYPE(piece) == KING) {
+        pos->kingSquare[PIECE_COLOR(piece)] = (uint8_t)to;
+    }
+}
+
+void positionPutPiece(Position* pos, int square, Piece piece) {
+    positionRemovePiece(pos, square);
+    if (piece == EMPTY) return;
+
+    setPiece(pos, square, piece);
+    pos->key ^= ZobristPiece[piece][square];
+    if (PIECE_TYPE(piece) == PAWN) pos->pawnKey ^= ZobristPiece[piece][square];
+    if (PIECE_TYPE(piece) == KING) {
+        pos->kingSquare[PIECE_COLOR(piece)] = (uint8_t)square;
+    }
+}
+
+void positionRemovePiece(Position* pos, int square) {
+    Piece piece = pos->board[square];
+    if (piece == EMPTY) return;
+
+    clearPiece(pos, square);
+    pos->key ^= ZobristPiece[piece][square];
+    if (PIECE_TYPE(piece) == PAWN) pos->pawnKey ^= ZobristPiece[piece][square];
+}
+
+void positionSetStart(Position* pos) {
+    static const PieceType backRank[] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+
+    positionClear(pos);
+    for (int col = 0; col < BOARD_SIZE; ++col) {
+        positionPutPiece(pos, SQUARE(0, col), MAKE_PIECE(WHITE, backRank[col]));
+        positionPutPiece(pos, SQUARE(1, col), MAKE_PIECE(WHITE, PAWN));
+        positionPutPiece(pos, SQUARE(6, col), MAKE_PIECE(BLACK, PAWN));
+        positionPutPiece(pos, SQUARE(7, col), MAKE_PIECE(BLACK, backRank[col]));
+    }
+    pos->castlingRights = ALL_CASTLING;
+    pos->key ^= ZobristCastling[ALL_CASTLING];
+}
+
+/* Whether the side to move has a pawn that could capture on @square */
+static inline bool epCapturable(const Position* pos, int square) {
+    return (PawnAttacks[OPPONENT(pos->sideToMove)][square] & positionPieces(pos, pos->sideToMove, PAWN)) != 0;
+}
+
+static const char* parseNumber(const char* c, uint16_t* value) {
+    unsigned number = 0;
+
+    if (*c < '0' || *c > '9') return NULL;
+    while (*c >= '0' && *c <= '9') {
+        number = number * 10 + (unsigned)(*c++ - '0');
+        if (number > UINT16_MAX) return NULL;
+    }
+    *value = (uint16_t)number;
+    return c;
+}
+
+/**
+ * parseFields - reads the four board fields shared by FEN and EPD:
+ * placement, side to move, castling rights and en-passant square.
+ * Rights whose king or rook is not at home are dropped.
+ *
+ * Return: the first character after the fields, NULL if malformed
+ */
+static const char* parseFields(Position* pos, const char* c) {
+    int row = BOARD_SIZE - 1, col = 0;
+
+    positionClear(pos);
+    for (; *c && *c != ' '; ++c) {
+        const char* found;
+
+        if (*c == '/') {
+            if (col != BOARD_SIZE || row == 0) return NULL;
+            row--;
+            col = 0;
+        } else if (*c >= '1' && *c <= '8') {
+            col += *c - '0';
+        } else if ((found = strchr(PieceChars, *c)) && *c != ' ' && col < BOARD_SIZE) {
+            positionPutPiece(pos, SQUARE(row, col), (Piece)(found - PieceChars));
+            col++;
+        } else {
+            return NULL;
+        }
+        if (col > BOARD_SIZE) return NULL;
+    }
+    if (row != 0 || col != BOARD_SIZE) return NULL;
+    if (popCount(positionPieces(pos, WHITE, KING)) != 1 || popCount(positionPieces(pos, BLACK, KING)) != 1) return NULL;
+
+    while (*c == ' ') c++;
+    if (*c == 'w') {
+        pos->sideToMove = WHITE;
+    } else if (*c == 'b') {
+        pos->sideToMove = BLACK;
+        pos->key ^= ZobristSide;
+    } else {
+        return NULL;
+    }
+    c++;
+
+    while (*c == ' ') c++;
+    if (*c == '-') {
+        c++;
+    } else {
+        for (; *c && *c != ' '; ++c) {
+            switch (*c) {
+                case 'K': pos->castlingRights |= WHITE_OO; break;
+                case 'Q': pos->castlingRights |= WHITE_OOO; break;
+                case 'k': pos->castlingRights |= BLACK_OO; break;
+                case 'q': pos->castlingRights |= BLACK_OOO; break;
+                default: return NULL;
+            }
+        }
+    }
+    if (pos->board[SQUARE(0, 4)] != MAKE_PIECE(WHITE, KING)) pos->castlingRights &= ~(WHITE_OO | WHITE_OOO);
+    if (pos->board[SQUARE(0, 7)] != MAKE_PIECE(WHITE, ROOK)) pos->castlingRights &= ~WHITE_OO;
+    if (pos->board[SQUARE(0, 0)] != MAKE_PIECE(WHITE, ROOK)) pos->castlingRights &= ~WHITE_OOO;
+    if (pos->board[SQUARE(7, 4)] != MAKE_PIECE(BLACK, KING)) pos->castlingRights &= ~(BLACK_OO | BLACK_OOO);
+    if (pos->board[SQUARE(7, 7)] != MAKE_PIECE(BLACK, ROOK)) pos->castlingRights &= ~BLACK_OO;
+    if (pos->board[SQUARE(7, 0)] != MAKE_PIECE(BLACK, ROOK)) pos->castlingRights &= ~BLACK_OOO;
+    pos->key ^= ZobristCastling[pos->castlingRights];
+
+    while (*c == ' ') c++;
+    if (*c == '-') {
+        c++;
+    } else if (*c >= 'a' && *c <= 'h' && (c[1] == '3' || c[1] == '6')) {
+        int square = SQUARE(c[1] - '1', *c - 'a');
+        int pushed = (pos->sideToMove == WHITE) ? square - BOARD_SIZE : square + BOARD_SIZE;
+
+        if (c[1] != ((pos->sideToMove == WHITE) ? '6' : '3')) return NULL;
+        if (pos->board[pushed] == MAKE_PIECE(OPPONENT(pos->sideToMove), PAWN) && epCapturable(pos, square)) {
+            pos->epSquare = (uint8_t)square;
+            pos->key ^= ZobristEnPassant[COL_OF(square)];
+        }
+        c += 2;
+    } else {
+        return NULL;
+    }
+    return c;
+}
+
+/**
+ * positionSetFen - loads a FEN string; the two move clocks may be left
+ * out (as in EPD) and then default to 0 and 1
+ *
+ * Return: true on success, false (and @pos cleared) on a malformed FEN
+ */
+bool positionSetFen(Position* pos, const char* fen) {
+    const char* c = parseFields(pos, fen);
+
+    if (!c) goto invalid;
+    while (*c == ' ') c++;
+    if (*c) {
+        if (!(c = parseNumber(c, &pos->rule50))) goto invalid;
+        while (*c == ' ') c++;
+        if (!(c = parseNumber(c, &pos->fullmoveNumber))) goto invalid;
+        if (pos->fullmoveNumber == 0) pos->fullmoveNumber = 1;
+    }
+    return true;
+
+invalid:
+    positionClear(pos);
+    return false;
+}
+
+/**
+ * positionSetEpd - loads the four board fields of an EPD record
+ *
+ * Return: the operations that follow them (e.g. "bm Nf3; id \"x\";"),
+ *         NULL (and @pos cleared) on a malformed record
+ */
+const char* positionSetEpd(Position* pos, const char* epd) {
+    const char* c = parseFields(pos, epd);
+
+    if (!c) {
+        positionClear(pos);
+        return NULL;
+    }
+    while (*c == ' ') c++;
+    return c;
+}
+
+/**
+ * positionToEpd - writes the four board fields of @pos into @buffer,
+ * which must hold at least FEN_MAX bytes
+ *
+ * Return: @buffer
+ */
+char* positionToEpd(const Position* pos, char* buffer) {
+    char* out = buffer;
+
+    for (int row = BOARD_SIZE - 1; row >= 0; --row) {
+        int empty = 0;
+
+        for (int col = 0; col < BOARD_SIZE; ++col) {
+            Piece piece = pos->board[SQUARE(row, col)];
+
+            if (piece == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty) *out++ = (char)('0' + empty);
+            empty = 0;
+            *out++ = PieceChars[piece];
+        }
+        if (empty) *out++ = (char)('0' + empty);
+        if (row > 0) *out++ = '/';
+    }
+
+    *out++ = ' ';
+    *out++ = (pos->sideToMove == WHITE) ? 'w' : 'b';
+    *out++ = ' ';
+    if (!pos->castlingRights) *out++ = '-';
+    if (pos->castlingRights & WHITE_OO) *out++ = 'K';
+    if (pos->castlingRights & WHITE_OOO) *out++ = 'Q';
+    if (pos->castlingRights & BLACK_OO) *out++ = 'k';
+    if (pos->castlingRights & BLACK_OOO) *out++ = 'q';
+    *out++ = ' ';
+    if (pos->epSquare == SQUARE_NONE) {
+        *out++ = '-';
+    } else {
+        *out++ = (char)('a' + COL_OF(pos->epSquare));
+        *out++ = (char)('1' + ROW_OF(pos->epSquare));
+    }
+    *out = '\0';
+    return buffer;
+}
+
+/**
+ * positionToFen - writes @pos as a full FEN string into @buffer, which
+ * must hold at least FEN_MAX bytes
+ *
+ * Return: @buffer
+ */
+char* positionToFen(const Position* pos, char* buffer) {
+    size_t length = strlen(positionToEpd(pos, buffer));
+
+    snprintf(buffer + length, FEN_MAX - length, " %u %u", (unsigned)pos->rule50, (unsigned)pos->fullmoveNumber);
+    return buffer;
+}
+
+/**
+ * positionAttackersTo - every piece of either color attacking @square,
+ * with sliders seen through @occupied
+ */
+Bitboard positionAttackersTo(const Position* pos, int square, Bitboard occupied) {
+    return (PawnAttacks[BLACK][square] & positionPieces(pos, WHITE, PAWN))
+         | (PawnAttacks[WHITE][square] & positionPieces(pos, BLACK, PAWN))
+         | (KnightAttacks[square] & pos->byType[KNIGHT])
+         | (KingAttacks[square] & pos->byType[KING])
+         | (bishopAttacks(square, occupied) & (pos->byType[BISHOP] | pos->byType[QUEEN]))
+         | (rookAttacks(square, occupied) & (pos->byType[ROOK] | pos->byType[QUEEN]));
+}
+
+bool positionIsSquareAttacked(const Position* pos, int square, PieceColor by) {
+    return (positionAttackersTo(pos, square, positionOccupied(pos)) & pos->byColor[by]) != 0;
+}
+
+bool positionInCheck(const Position* pos, PieceColor color) {
+    STATS_INC(STAT_CHECK_TESTS);
+    if (!positionPieces(pos, color, KING)) return false;
+    return positionIsSquareAttacked(pos, pos->kingSquare[color], OPPONENT(color));
+}
+
+/**
+ * positionMakeMove - plays @move, updating board, bitboards, piece
+ * counts, king squares, game state and the hash key incrementally;
+ * @undo receives what positionUnmakeMove needs to take the move back
+ */
+void positionMakeMove(Position* pos, Move move, UndoInfo* undo) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    int captureSquare = (MOVE_TYPE(move) == MOVE_EN_PASSANT) ? to ^ 8 : to;
+    Piece piece = pos->board[from];
+    Piece captured = pos->board[captureSquare];
+    uint64_t key = pos->key ^ ZobristSide;
+    NnueAccumulator* nnue = pos->nnue;
+
+    undo->previous = pos->history;
+    undo->key = pos->key;
+    undo->pawnKey = pos->pawnKey;
+    undo->captured = captured;
+    undo->castlingRights = pos->castlingRights;
+    undo->epSquare = pos->epSquare;
+    undo->rule50 = pos->rule50;
+    pos->history = undo;
+
+    if (nnue) {
+        pos->nnue = ++nnue;
+        nnue->computed = false;
+        nnue->dirtyCount = 0;
+    }
+
+    if (pos->epSquare != SQUARE_NONE) {
+        key ^= ZobristEnPassant[COL_OF(pos->epSquare)];
+        pos->epSquare = SQUARE_NONE;
+    }
+    if (pos->castlingRights && (CastlingMask[from] | CastlingMask[to])) {
+        key ^= ZobristCastling[pos->castlingRights];
+        pos->castlingRights &= (uint8_t)~(CastlingMask[from] | CastlingMask[to]);
+        key ^= ZobristCastling[pos->castlingRights];
+    }
+
+    if (captured != EMPTY) {
+        clearPiece(pos, captureSquare);
+        key ^= ZobristPiece[captured][captureSquare];
+        if (PIECE_TYPE(captured) == PAWN) pos->pawnKey ^= ZobristPiece[captured][captureSquare];
+        if (nnue) nnueMarkDirty(nnue, captured, captureSquare, SQUARE_NONE);
+    }
+    shiftPiece(pos, from, to);
+    if (nnue) nnueMarkDirty(nnue, piece, from, to);
+    key ^= ZobristPiece[piece][from] ^ ZobristPiece[piece][to];
+    if (PIECE_TYPE(piece) == PAWN) pos->pawnKey ^= ZobristPiece[piece][from] ^ ZobristPiece[piece][to];
+
+    if (MOVE_TYPE(move) == MOVE_CASTLING) {
+        int rookFrom = (to > from) ? to + 1 : to - 2, rookTo = (from + to) / 2;
+        Piece rook = pos->board[rookFrom];
+
+        shiftPiece(pos, rookFrom, rookTo);
+        key ^= ZobristPiece[rook][rookFrom] ^ ZobristPiece[rook][rookTo];
+        if (nnue) nnueMarkDirty(nnue, rook, rookFrom, rookTo);
+    } else if (MOVE_TYPE(move) == MOVE_PROMOTION) {
+        Piece promoted = MAKE_PIECE(pos->sideToMove, MOVE_PROMOTED(move));
+
+        clearPiece(pos, to);
+        setPiece(pos, to, promoted);
+        key ^= ZobristPiece[piece][to] ^ ZobristPiece[promoted][to];
+        pos->pawnKey ^= ZobristPiece[piece][to];
+        if (nnue) {
+            /* the pawn leaves the board instead of arriving on it */
+            nnue->dirtyTo[nnue->dirtyCount - 1] = SQUARE_NONE;
+            nnueMarkDirty(nnue, promoted, SQUARE_NONE, to);
+        }
+    }
+
+    pos->rule50 = (captured != EMPTY || PIECE_TYPE(piece) == PAWN) ? 0 : pos->rule50 + 1;
+    if (pos->sideToMove == BLACK) pos->fullmoveNumber++;
+    pos->sideToMove = OPPONENT(pos->sideToMove);
+
+    if (PIECE_TYPE(piece) == PAWN && (to ^ from) == 16 && epCapturable(pos, (from + to) / 2)) {
+        pos->epSquare = (uint8_t)((from + to) / 2);
+        key ^= ZobristEnPassant[COL_OF(pos->epSquare)];
+    }
+    pos->key = key;
+}
+
+void positionUnmakeMove(Position* pos, Move move, const UndoInfo* undo) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+
+    pos->sideToMove = OPPONENT(pos->sideToMove);
+    if (pos->sideToMove == BLACK) pos->fullmoveNumber--;
+
+    if (MOVE_TYPE(move) == MOVE_PROMOTION) {
+        clearPiece(pos, to);
+        setPiece(pos, to, MAKE_PIECE(pos->sideToMove, PAWN));
+    } else if (MOVE_TYPE(move) == MOVE_CASTLING) {
+        shiftPiece(pos, (from + to) / 2, (to > from) ? to + 1 : to - 2);
+    }
+    shiftPiece(pos, to, from);
+    if (undo->captured != EMPTY) {
+        setPiece(pos, (MOVE_TYPE(move) == MOVE_EN_PASSANT) ? to ^ 8 : to, undo->captured);
+    }
+
+    pos->key = undo->key;
+    pos->pawnKey = undo->pawnKey;
+    pos->castlingRights = undo->castlingRights;
+    pos->epSquare = undo->epSquare;
+    pos->rule50 = undo->rule50;
+    pos->history = undo->previous;
+    if (pos->nnue) pos->nnue--;
+}
+
+/**
+ * positionIsDraw - fifty-move rule or repetition, found by walking the
+ * key chain back over the reversible moves. Inside a search @ply moves
+ * deep a single repetition of a position at or after the root is a
+ * draw; earlier positions must have occurred twice (threefold). With
+ * @ply 0 this is the game rule. Checkmate on the move that completes
+ * the fifty moves stands (FIDE 9.3), so that case is not a draw.
+ */
+bool positionIsDraw(const Position* pos, int ply) {
+    const UndoInfo* undo = pos->history;
+    int repetitions = 0;
+
+    if (pos->rule50 >= 100) return !positionIsCheckMate(pos);
+
+    for (int back = 1; undo && back <= pos->rule50; ++back, undo = undo->previous) {
+        if ((back & 1) || undo->key != pos->key) continue;
+        if (back <= ply || ++repetitions == 2) return true;
+    }
+    return false;
+}
+
+/**
+ * positionComputeKey - hashes @pos from scratch; the incremental key
+ * must always equal this
+ */
+uint64_t positionComputeKey(const Position* pos) {
+    uint64_t key = (pos->sideToMove == BLACK) ? ZobristSide : 0;
+
+    key ^= ZobristCastling[pos->castlingRights];
+    if (pos->epSquare != SQUARE_NONE) key ^= ZobristEnPassant[COL_OF(pos->epSquare)];
+    for (int square = 0; square < SQUARE_NB; ++square) {
+        key ^= ZobristPiece[pos->board[square]][square];
+    }
+    return key;
+}
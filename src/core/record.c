@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include "record.h"
+
+static RecordEntry* entryAt(const GameRecord* record, int ply) {
+    return &record->blocks[ply / RECORD_BLOCK_MOVES][ply % RECORD_BLOCK_MOVES];
+}
+
+/**
+ * recordInit - an empty record for a game starting from @start
+ */
+void recordInit(GameRecord* record, const Position* start) {
+    memset(record, 0, sizeof(*record));
+    record->start = *start;
+    record->start.history = NULL;
+}
+
+/**
+ * recordReset - forgets every move and starts over from @start; the
+ * blocks are kept for the next game
+ */
+void recordReset(GameRecord* record, const Position* start) {
+    record->start = *start;
+    record->start.history = NULL;
+    record->ply = record->length = 0;
+}
+
+void recordFree(GameRecord* record) {
+    for (int i = 0; i < record->blockCount; ++i) {
+        free(record->blocks[i]);
+    }
+    free(record->blocks);
+    record->blocks = NULL;
+    record->blockCount = 0;
+    record->ply = record->length = 0;
+}
+
+/**
+ * recordPlay - makes @move on @pos, the position the record is at, and
+ * records it in place of any moves that were taken back
+ *
+ * Return: false (and @pos untouched) if a new block could not be
+ * allocated
+ */
+bool recordPlay(GameRecord* record, Position* pos, Move move) {
+    RecordEntry* entry;
+
+    if (record->ply == record->blockCount * RECORD_BLOCK_MOVES) {
+        RecordEntry** blocks = realloc(record->blocks, (size_t)(record->blockCount + 1) * sizeof(RecordEntry*));
+
+        if (!blocks) return false;
+        record->blocks = blocks;
+        if (!(blocks[record->blockCount] = malloc(RECORD_BLOCK_MOVES * sizeof(RecordEntry)))) return false;
+        record->blockCount++;
+    }
+
+    entry = entryAt(record, record->ply++);
+    entry->move = move;
+    record->length = record->ply;
+    positionMakeMove(pos, move, &entry->undo);
+    return true;
+}
+
+/**
+ * recordUndo - takes the last move back on @pos, keeping it for redo
+ *
+ * Return: false if the record is at the start position
+ */
+bool recordUndo(GameRecord* record, Position* pos) {
+    RecordEntry* entry;
+
+    if (record->ply == 0) return false;
+    entry = entryAt(record, --record->ply);
+    positionUnmakeMove(pos, entry->move, &entry->undo);
+    return true;
+}
+
+/**
+ * recordRedo - plays the next move taken back by recordUndo again
+ *
+ * Return: false if there is none
+ */
+bool recordRedo(GameRecord* record, Position* pos) {
+    RecordEntry* entry;
+
+    if (record->ply == record->length) return false;
+    entry = entryAt(record, record->ply++);
+    positionMakeMove(pos, entry->move, &entry->undo);
+    return true;
+}
@@ -0,0 +1,565 @@
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+#include "bitbase.h"
+#include "eval.h"
+#include "misc.h"
+#include "stats.h"
+
+#define SCORE_PV_MOVE 3000000
+#define SCORE_CAPTURE 2000000
+#define SCORE_KILLER_1 1000002
+#define SCORE_KILLER_2 1000001
+#define HISTORY_MAX 1000000
+#define THREAD_STACK_SIZE (8 * 1024 * 1024)
+
+/* Lazy SMP depth staggering: helper n skips some iterations so the
+ * threads spread over neighbouring depths instead of all searching the
+ * same one */
+static const int SkipSize[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SkipPhase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+static inline bool stopRequested(const Search* search) {
+    return __atomic_load_n(&search->stop, __ATOMIC_RELAXED);
+}
+
+static inline void requestStop(Search* search) {
+    __atomic_store_n(&search->stop, true, __ATOMIC_RELAXED);
+}
+
+/* Node counters are written only by their owner and read by thread 0 */
+static inline void countNode(SearchThread* thread) {
+    __atomic_store_n(&thread->nodes, thread->nodes + 1, __ATOMIC_RELAXED);
+}
+
+static void setupTimeLimits(Search* search, PieceColor us) {
+    const SearchLimits* limits = &search->limits;
+
+    search->softLimit = search->hardLimit = 0;
+    if (limits->infinite) return;
+
+    if (limits->moveTime) {
+        search->softLimit = search->hardLimit = limits->moveTime;
+    } else if (limits->time[us]) {
+        int movesLeft = limits->movesToGo ? limits->movesToGo : 30;
+        int64_t budget = limits->time[us] / movesLeft + limits->increment[us] * 3 / 4;
+        int64_t maximum = limits->time[us] - 50;
+
+        if (maximum < 1) maximum = 1;
+        search->hardLimit = (budget * 3 < maximum) ? budget * 3 : maximum;
+        search->softLimit = (budget < search->hardLimit) ? budget : search->hardLimit;
+    }
+}
+
+/* Polled by thread 0 every 1024 nodes; its first iteration always
+ * completes so there is a move to play however tight the limits are */
+static void checkLimits(SearchThread* thread) {
+    Search* search = thread->search;
+
+    if (thread->id != 0 || thread->completedDepth == 0) return;
+
+    if (search->limits.nodes && searchNodes(search) >= search->limits.nodes) {
+        requestStop(search);
+    }
+    if (search->hardLimit && timeNowMs() - search->startTime >= search->hardLimit) {
+        requestStop(search);
+    }
+}
+
+/**
+ * scoreMoves - ordering keys: hash or previous PV move, then captures by
+ * MVV-LVA and promotions, then the two killers, then quiet moves by
+ * history
+ */
+static void scoreMoves(const SearchThread* thread, const MoveList* list, int* scores, int ply, Move pvMove) {
+    const Position* pos = &thread->pos;
+
+    for (int i = 0; i < list->count; ++i) {
+        Move move = list->moves[i];
+        Piece moved = pos->board[MOVE_FROM(move)];
+        PieceType captured = (MOVE_TYPE(move) == MOVE_EN_PASSANT) ? PAWN : PIECE_TYPE(pos->board[MOVE_TO(move)]);
+
+        if (move == pvMove) {
+            scores[i] = SCORE_PV_MOVE;
+        } else if (captured != EMPTY) {
+            scores[i] = SCORE_CAPTURE + captured * 8 - PIECE_TYPE(moved);
+        } else if (MOVE_TYPE(move) == MOVE_PROMOTION) {
+            scores[i] = SCORE_CAPTURE + MOVE_PROMOTED(move) - KNIGHT;
+        } else if (move == thread->killers[ply][0]) {
+            scores[i] = SCORE_KILLER_1;
+        } else if (move == thread->killers[ply][1]) {
+            scores[i] = SCORE_KILLER_2;
+        } else {
+            scores[i] = thread->history[moved][MOVE_TO(move)];
+        }
+    }
+}
+
+/* Selection sort step: brings the best remaining move to @index */
+static Move pickMove(MoveList* list, int* scores, int index) {
+    int best = index;
+
+    for (int i = index + 1; i < list->count; ++i) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    if (best != index) {
+        Move move = list->moves[best];
+        int score = scores[best];
+        list->moves[best] = list->moves[index];
+        scores[best] = scores[index];
+        list->moves[index] = move;
+        scores[index] = score;
+    }
+    return list->moves[index];
+}
+
+static void updateQuietStats(SearchThread* thread, Move move, int depth, int ply) {
+    int* entry = &thread->history[thread->pos.board[MOVE_FROM(move)]][MOVE_TO(move)];
+
+    if (thread->killers[ply][0] != move) {
+        thread->killers[ply][1] = thread->killers[ply][0];
+        thread->killers[ply][0] = move;
+    }
+
+    *entry += depth * depth;
+    if (*entry > HISTORY_MAX) {
+        for (int piece = 0; piece < PIECE_NB; ++piece) {
+            for (int square = 0; square < SQUARE_NB; ++square) {
+                thread->history[piece][square] /= 2;
+            }
+        }
+    }
+}
+
+static void updatePv(SearchThread* thread, Move move, int ply) {
+    thread->pvTable[ply][ply] = move;
+    for (int i = ply + 1; i < thread->pvLength[ply + 1]; ++i) {
+        thread->pvTable[ply][i] = thread->pvTable[ply + 1][i];
+    }
+    thread->pvLength[ply] = thread->pvLength[ply + 1];
+}
+
+static Move previousPvMove(const SearchThread* thread, int ply) {
+    return (ply < thread->info.pvLength) ? thread->info.pv[ply] : MOVE_NONE;
+}
+
+/* Mate scores are stored relative to the node, not the root */
+static int scoreToTT(int score, int ply) {
+    if (score >= VALUE_MATE_IN_MAX_PLY) return score + ply;
+    if (score <= -VALUE_MATE_IN_MAX_PLY) return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+    if (score >= VALUE_MATE_IN_MAX_PLY) return score - ply;
+    if (score <= -VALUE_MATE_IN_MAX_PLY) return score + ply;
+    return score;
+}
+
+static bool ttCutoff(const TTData* entry, int score, int alpha, int beta) {
+    return entry->bound == BOUND_EXACT
+        || (entry->bound == BOUND_LOWER && score >= beta)
+        || (entry->bound == BOUND_UPPER && score <= alpha);
+}
+
+/**
+ * quiescence - resolves captures until the position is quiet so the
+ * static evaluation is not taken in the middle of an exchange; in check
+ * every evasion is searched instead
+ */
+static int quiescence(SearchThread* thread, int alpha, int beta, int ply) {
+    Search* search = thread->search;
+    Position* pos = &thread->pos;
+    bool inCheck = positionInCheck(pos, pos->sideToMove);
+    int scores[MAX_MOVES];
+    MoveList list;
+    UndoInfo undo;
+    TTData entry;
+    bool ttHit;
+    BitbaseResult known;
+    int best = -VALUE_INFINITE;
+    int eval = VALUE_NONE;
+    int originalAlpha = alpha;
+    Move bestMove = MOVE_NONE;
+
+    countNode(thread);
+    STATS_INC(STAT_QNODES);
+    if ((thread->nodes & 1023) == 0) checkLimits(thread);
+    if (stopRequested(search)) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(pos, &thread->pawns);
+
+    if ((known = bitbaseProbe(pos)) != BITBASE_UNKNOWN) {
+        if (known == BITBASE_DRAW || !search->rootInBitbase) return bitbaseScore(pos, known);
+    }
+
+    if (search->tt) STATS_INC(STAT_TT_PROBES);
+    ttHit = search->tt && ttProbe(search->tt, pos->key, &entry);
+    if (ttHit) {
+        int ttScore = scoreFromTT(entry.score, ply);
+
+        STATS_INC(STAT_TT_HITS);
+        if (beta - alpha == 1 && ttCutoff(&entry, ttScore, alpha, beta)) {
+            STATS_INC(STAT_TT_CUTOFFS);
+            return ttScore;
+        }
+        eval = entry.eval;
+    }
+    if (known != BITBASE_UNKNOWN) eval = bitbaseScore(pos, known);
+
+    if (!inCheck) {
+        if (eval == VALUE_NONE) eval = evaluate(pos, &thread->pawns);
+        best = eval;
+        if (best >= beta) {
+            if (search->tt && !ttHit) ttStore(search->tt, pos->key, MOVE_NONE, scoreToTT(best, ply), eval, 0, BOUND_LOWER);
+            return best;
+        }
+        if (best > alpha) alpha = best;
+        generateCaptures(pos, &list);
+    } else {
+        generateLegalMoves(pos, &list);
+    }
+
+    scoreMoves(thread, &list, scores, ply, ttHit ? entry.move : MOVE_NONE);
+    for (int i = 0; i < list.count; ++i) {
+        Move move = pickMove(&list, scores, i);
+        int score;
+
+        positionMakeMove(pos, move, &undo);
+        score = -quiescence(thread, -beta, -alpha, ply + 1);
+        positionUnmakeMove(pos, move, &undo);
+
+        if (stopRequested(search)) return 0;
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                bestMove = move;
+                if (alpha >= beta) break;
+            }
+        }
+    }
+
+    if (inCheck && list.count == 0) return -VALUE_MATE + ply;
+
+    if (search->tt) {
+        Bound bound = (best >= beta) ? BOUND_LOWER : (best > originalAlpha) ? BOUND_EXACT : BOUND_UPPER;
+        ttStore(search->tt, pos->key, bestMove, scoreToTT(best, ply), eval, 0, bound);
+    }
+    return best;
+}
+
+/**
+ * alphaBeta - principal variation search: the first move gets the full
+ * window, later ones a null window and a re-search only if they beat
+ * alpha
+ */
+static int alphaBeta(SearchThread* thread, int alpha, int beta, int depth, int ply) {
+    Search* search = thread->search;
+    Position* pos = &thread->pos;
+    bool inCheck = positionInCheck(pos, pos->sideToMove);
+    int scores[MAX_MOVES];
+    MoveList list;
+    UndoInfo undo;
+    TTData entry;
+    bool pvNode = beta - alpha > 1;
+    BitbaseResult known;
+    int best = -VALUE_INFINITE;
+    int originalAlpha = alpha;
+    Move bestMove = MOVE_NONE;
+    Move ttMove = MOVE_NONE;
+
+    thread->pvLength[ply] = ply;
+    if (inCheck) depth++;
+    if (depth <= 0) return quiescence(thread, alpha, beta, ply);
+
+    countNode(thread);
+    STATS_INC(STAT_NODES);
+    if ((thread->nodes & 1023) == 0) checkLimits(thread);
+    if (stopRequested(search)) return 0;
+    if (ply > 0 && positionIsDraw(pos, ply)) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(pos, &thread->pawns);
+
+    /* A covered ending resolves here, except that wins are searched out
+     * when the game is already in one, or the engine would never mate */
+    if (ply > 0 && (known = bitbaseProbe(pos)) != BITBASE_UNKNOWN) {
+        if (known == BITBASE_DRAW || !search->rootInBitbase) return bitbaseScore(pos, known);
+    }
+
+    if (search->tt) STATS_INC(STAT_TT_PROBES);
+    if (search->tt && ttProbe(search->tt, pos->key, &entry)) {
+        int ttScore = scoreFromTT(entry.score, ply);
+
+        STATS_INC(STAT_TT_HITS);
+        if (!pvNode && ply > 0 && entry.depth >= depth && ttCutoff(&entry, ttScore, alpha, beta)) {
+            STATS_INC(STAT_TT_CUTOFFS);
+            return ttScore;
+        }
+        ttMove = entry.move;
+    }
+
+    generateLegalMoves(pos, &list);
+    scoreMoves(thread, &list, scores, ply, ttMove ? ttMove : previousPvMove(thread, ply));
+
+    for (int i = 0; i < list.count; ++i) {
+        Move move = pickMove(&list, scores, i);
+        bool quiet = !positionIsCapture(pos, move) && MOVE_TYPE(move) != MOVE_PROMOTION;
+        int score;
+
+        positionMakeMove(pos, move, &undo);
+        if (i == 0) {
+            score = -alphaBeta(thread, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            score = -alphaBeta(thread, -alpha - 1, -alpha, depth - 1, ply + 1);
+            if (score > alpha && score < beta) {
+                score = -alphaBeta(thread, -beta, -alpha, depth - 1, ply + 1);
+            }
+        }
+        positionUnmakeMove(pos, move, &undo);
+
+        if (stopRequested(search)) return 0;
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                bestMove = move;
+                updatePv(thread, move, ply);
+                if (alpha >= beta) {
+                    if (quiet) updateQuietStats(thread, move, depth, ply);
+                    STATS_CUTOFF(i);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (list.count == 0) return inCheck ? -VALUE_MATE + ply : 0;
+
+    if (search->tt) {
+        Bound bound = (best >= beta) ? BOUND_LOWER : (best > originalAlpha) ? BOUND_EXACT : BOUND_UPPER;
+        ttStore(search->tt, pos->key, bestMove, scoreToTT(best, ply), VALUE_NONE, depth, bound);
+    }
+    return best;
+}
+
+static void resetThread(SearchThread* thread, const Position* pos) {
+    thread->pos = *pos;
+    thread->nodes = 0;
+    thread->completedDepth = 0;
+    memset(&thread->info, 0, sizeof(thread->info));
+    memset(thread->killers, 0, sizeof(thread->killers));
+    memset(thread->history, 0, sizeof(thread->history));
+    thread->pawns.probes = thread->pawns.hits = 0;
+    thread->pos.nnue = nnueLoaded() ? thread->accumulators : NULL;
+    if (thread->pos.nnue) nnueReset(thread->pos.nnue);
+}
+
+/**
+ * iterativeDeepening - the per-thread driver. Helpers stagger their
+ * depths and run until thread 0 raises the stop flag; thread 0 applies
+ * the limits and reports each completed iteration.
+ */
+static void iterativeDeepening(SearchThread* thread, const MoveList* rootMoves) {
+    Search* search = thread->search;
+    int maxDepth = (search->limits.depth > 0 && search->limits.depth < MAX_PLY) ? search->limits.depth : MAX_PLY - 1;
+    SearchInfo* info = &thread->info;
+
+    statsAttach();
+
+    if (rootMoves->count > 0) {
+        info->pv[0] = rootMoves->moves[0];
+        info->pvLength = 1;
+    }
+
+    for (int depth = 1; depth <= maxDepth && rootMoves->count > 0; ++depth) {
+        if (thread->id > 0) {
+            int i = (thread->id - 1) % 20;
+            if (((depth + SkipPhase[i]) / SkipSize[i]) % 2) continue;
+        }
+
+        int score = alphaBeta(thread, -VALUE_INFINITE, VALUE_INFINITE, depth, 0);
+        if (stopRequested(search)) break;
+
+        thread->completedDepth = depth;
+        info->depth = depth;
+        info->score = score;
+        info->pvLength = thread->pvLength[0];
+        memcpy(info->pv, thread->pvTable[0], sizeof(Move) * (size_t)info->pvLength);
+
+        if (thread->id != 0) continue;
+
+        info->nodes = searchNodes(search);
+        info->elapsedMs = timeNowMs() - search->startTime;
+        info->nps = info->nodes * 1000 / (uint64_t)(info->elapsedMs > 0 ? info->elapsedMs : 1);
+        info->hashfull = search->tt ? ttHashfull(search->tt) : 0;
+        if (search->onIteration) search->onIteration(info, search->userData);
+
+        if (search->limits.nodes && info->nodes >= search->limits.nodes) break;
+        if (search->softLimit && info->elapsedMs >= search->softLimit) break;
+    }
+}
+
+typedef struct {
+    SearchThread* thread;
+    const MoveList* rootMoves;
+} HelperArgs;
+
+static void* helperMain(void* arg) {
+    HelperArgs* args = arg;
+    iterativeDeepening(args->thread, args->rootMoves);
+    return NULL;
+}
+
+/**
+ * searchInit - prepares an empty search with @threadCount workers
+ *
+ * Return: false if the worker tables could not be allocated
+ */
+bool searchInit(Search* search, int threadCount) {
+    memset(search, 0, sizeof(*search));
+    search->pawnHashKb = PAWN_HASH_DEFAULT_KB;
+    return searchSetThreads(search, threadCount);
+}
+
+/**
+ * searchSetThreads - resizes the worker pool; must not be called while
+ * a search is running
+ *
+ * Return: false if the allocation failed (the old pool is kept)
+ */
+bool searchSetThreads(Search* search, int threadCount) {
+    SearchThread* threads;
+
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    if (threadCount == search->threadCount) return true;
+
+    threads = calloc((size_t)threadCount, sizeof(SearchThread));
+    if (!threads) return false;
+
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].search = search;
+        threads[i].id = i;
+        if (!pawnTableResize(&threads[i].pawns, search->pawnHashKb)) {
+            while (i >= 0) pawnTableFree(&threads[i--].pawns);
+            free(threads);
+            return false;
+        }
+    }
+
+    searchFree(search);
+    search->threads = threads;
+    search->threadCount = threadCount;
+    return true;
+}
+
+/**
+ * searchSetPawnHash - gives every thread a pawn cache of @sizeKb
+ * kilobytes (0 disables it); must not be called while searching
+ *
+ * Return: false if an allocation failed (that thread then has none)
+ */
+bool searchSetPawnHash(Search* search, size_t sizeKb) {
+    bool ok = true;
+
+    search->pawnHashKb = sizeKb;
+    for (int i = 0; i < search->threadCount; ++i) {
+        ok = pawnTableResize(&search->threads[i].pawns, sizeKb) && ok;
+    }
+    return ok;
+}
+
+void searchFree(Search* search) {
+    for (int i = 0; i < search->threadCount; ++i) {
+        pawnTableFree(&search->threads[i].pawns);
+    }
+    free(search->threads);
+    search->threads = NULL;
+    search->threadCount = 0;
+}
+
+/**
+ * searchRun - Lazy SMP iterative deepening from @pos until @limits are
+ * reached or searchStop is called. Helper threads are started for the
+ * duration of the call; the calling thread acts as thread 0. @result
+ * (optional) receives the deepest completed iteration. The stop flag is
+ * cleared on entry, so a stop left over from an earlier run is dropped.
+ *
+ * Return: best move, MOVE_NONE if the side to move has no legal move
+ */
+Move searchRun(Search* search, const Position* pos, const SearchLimits* limits, SearchInfo* result) {
+    HelperArgs args[MAX_THREADS];
+    pthread_attr_t attr;
+    MoveList rootMoves;
+    SearchThread* best;
+
+    __atomic_store_n(&search->stop, false, __ATOMIC_RELAXED);
+    search->limits = *limits;
+    search->startTime = timeNowMs();
+    search->rootInBitbase = bitbaseProbe(pos) != BITBASE_UNKNOWN;
+    setupTimeLimits(search, pos->sideToMove);
+    if (search->tt) ttNewSearch(search->tt);
+
+    generateLegalMoves(pos, &rootMoves);
+    for (int i = 0; i < search->threadCount; ++i) {
+        resetThread(&search->threads[i], pos);
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+    for (int i = 1; i < search->threadCount; ++i) {
+        args[i].thread = &search->threads[i];
+        args[i].rootMoves = &rootMoves;
+        search->threads[i].running = pthread_create(&search->threads[i].handle, &attr, helperMain, &args[i]) == 0;
+    }
+    pthread_attr_destroy(&attr);
+
+    iterativeDeepening(&search->threads[0], &rootMoves);
+
+    requestStop(search);
+    for (int i = 1; i < search->threadCount; ++i) {
+        if (search->threads[i].running) pthread_join(search->threads[i].handle, NULL);
+        search->threads[i].running = false;
+    }
+
+    /* A helper that got deeper than thread 0 has the better answer */
+    best = &search->threads[0];
+    for (int i = 1; i < search->threadCount; ++i) {
+        SearchThread* thread = &search->threads[i];
+        if (thread->completedDepth > best->completedDepth
+            || (thread->completedDepth == best->completedDepth && thread->info.score > best->info.score)) {
+            best = thread;
+        }
+    }
+
+    /* No iteration runs without root moves: the game is already over */
+    if (rootMoves.count == 0) best->info.score = positionInCheck(pos, pos->sideToMove) ? -VALUE_MATE : 0;
+    best->info.nodes = searchNodes(search);
+    best->info.elapsedMs = timeNowMs() - search->startTime;
+    best->info.nps = best->info.nodes * 1000 / (uint64_t)(best->info.elapsedMs > 0 ? best->info.elapsedMs : 1);
+    best->info.hashfull = search->tt ? ttHashfull(search->tt) : 0;
+    if (result) *result = best->info;
+    return best->info.pvLength > 0 ? best->info.pv[0] : MOVE_NONE;
+}
+
+/**
+ * searchStop - asks a running searchRun to return as soon as possible;
+ * safe to call from another thread. Only a run that has already
+ * started sees it: searchRun clears the flag on entry, so a caller that
+ * may stop a run before it begins has to repeat the stop once it runs,
+ * e.g. from onIteration.
+ */
+void searchStop(Search* search) {
+    requestStop(search);
+}
+
+/**
+ * searchNodes - nodes searched so far by all threads together
+ */
+uint64_t searchNodes(const Search* search) {
+    uint64_t nodes = 0;
+
+    for (int i = 0; i < search->threadCount; ++i) {
+        nodes += __atomic_load_n(&search->threads[i].nodes, __ATOMIC_RELAXED);
+    }
+    return nodes;
+}
@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char* StatNames[STAT_NB] = {
+    [STAT_NODES] = "nodes",
+    [STAT_QNODES] = "qnodes",
+    [STAT_TT_PROBES] = "tt_probes",
+    [STAT_TT_HITS] = "tt_hits",
+    [STAT_TT_CUTOFFS] = "tt_cutoffs",
+    [STAT_BETA_CUTOFFS] = "beta_cutoffs",
+    [STAT_MOVEGEN_CALLS] = "movegen_calls",
+    [STAT_MOVEGEN_NS] = "movegen_ns",
+    [STAT_EVAL_CALLS] = "eval_calls",
+    [STAT_EVAL_NS] = "eval_ns",
+    [STAT_CHECK_TESTS] = "check_tests",
+    [STAT_LEGALITY_TESTS] = "legality_tests",
+};
+
+#ifdef USE_STATS
+
+/**
+ * StatsLink - registry entry for one attached thread's block
+ */
+typedef struct StatsLink {
+    Stats* stats;
+    struct StatsLink* next;
+} StatsLink;
+
+__thread Stats ThreadStats;
+static __thread StatsLink ThreadLink;
+
+/* Attached threads, and what threads that have exited left behind */
+static pthread_mutex_t RegistryLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t RegistryOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t RegistryKey;
+static StatsLink* Live;
+static Stats Retired;
+
+static void addInto(Stats* total, const Stats* stats) {
+    for (int i = 0; i < STAT_NB; ++i) {
+        total->counters[i] += __atomic_load_n(&stats->counters[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < STATS_CUTOFF_SLOTS; ++i) {
+        total->cutoffAt[i] += __atomic_load_n(&stats->cutoffAt[i], __ATOMIC_RELAXED);
+    }
+}
+
+/* Thread exit: fold the block into Retired before it goes away */
+static void detach(void* arg) {
+    StatsLink* link = arg;
+
+    pthread_mutex_lock(&RegistryLock);
+    for (StatsLink** at = &Live; *at; at = &(*at)->next) {
+        if (*at == link) {
+            *at = link->next;
+            break;
+        }
+    }
+    addInto(&Retired, link->stats);
+    pthread_mutex_unlock(&RegistryLock);
+    link->stats = NULL;
+}
+
+static void createKey(void) {
+    pthread_key_create(&RegistryKey, detach);
+}
+
+uint64_t statsClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * statsAttach - makes the calling thread's counters part of the totals;
+ * cheap to repeat, so every search worker calls it as it starts. Counts made
+ * by a thread that never attached are not reported.
+ */
+void statsAttach(void) {
+    if (ThreadLink.stats) return;
+
+    pthread_once(&RegistryOnce, createKey);
+    ThreadLink.stats = &ThreadStats;
+    pthread_mutex_lock(&RegistryLock);
+    ThreadLink.next = Live;
+    Live = &ThreadLink;
+    pthread_mutex_unlock(&RegistryLock);
+    pthread_setspecific(RegistryKey, &ThreadLink);
+}
+
+/**
+ * statsCollect - the counters of every attached thread, alive or
+ * exited, summed into @total; safe while a search is running
+ */
+void statsCollect(Stats* total) {
+    pthread_mutex_lock(&RegistryLock);
+    *total = Retired;
+    for (StatsLink* link = Live; link; link = link->next) {
+        addInto(total, link->stats);
+    }
+    pthread_mutex_unlock(&RegistryLock);
+}
+
+/**
+ * statsReset - zeroes every counter; only while no other thread counts,
+ * e.g. between searches
+ */
+void statsReset(void) {
+    pthread_mutex_lock(&RegistryLock);
+    memset(&Retired, 0, sizeof(Retired));
+    for (StatsLink* link = Live; link; link = link->next) {
+        memset(link->stats, 0, sizeof(Stats));
+    }
+    pthread_mutex_unlock(&RegistryLock);
+}
+
+#else
+
+void statsCollect(Stats* total) {
+    memset(total, 0, sizeof(*total));
+}
+
+void statsReset(void) {
+}
+
+#endif
+
+const char* statsName(StatId id) {
+    return StatNames[id];
+}
+
+/**
+ * statsFormatJson - @stats as one JSON object, counters by name plus
+ * the "cutoff_at" array
+ *
+ * Return: the length snprintf would write, as with snprintf
+ */
+int statsFormatJson(const Stats* stats, char* buffer, size_t size) {
+    size_t length = 0;
+    int written;
+
+#define APPEND(...) do { \
+        written = snprintf(buffer + (length < size ? length : size), length < size ? size - length : 0, __VA_ARGS__); \
+        length += (size_t)written; \
+    } while (0)
+
+    APPEND("{");
+    for (int i = 0; i < STAT_NB; ++i) {
+        APPEND("\"%s\":%llu,", StatNames[i], (unsigned long long)stats->counters[i]);
+    }
+    APPEND("\"cutoff_at\":[");
+    for (int i = 0; i < STATS_CUTOFF_SLOTS; ++i) {
+        APPEND("%s%llu", i ? "," : "", (unsigned long long)stats->cutoffAt[i]);
+    }
+    APPEND("]}");
+#undef APPEND
+    return (int)length;
+}
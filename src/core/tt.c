@@ -0,0 +1,165 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "tt.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define GENERATION_MASK 63
+
+static inline uint64_t packData(Move move, int score, int eval, int depth, Bound bound, uint8_t generation) {
+    return (uint64_t)move
+         | (uint64_t)(uint16_t)score << 16
+         | (uint64_t)(uint16_t)eval << 32
+         | (uint64_t)(uint8_t)depth << 48
+         | (uint64_t)bound << 56
+         | (uint64_t)(generation & GENERATION_MASK) << 58;
+}
+
+static inline int dataDepth(uint64_t data) {
+    return (int)((data >> 48) & 0xFF);
+}
+
+static inline Bound dataBound(uint64_t data) {
+    return (Bound)((data >> 56) & 3);
+}
+
+static inline uint8_t dataGeneration(uint64_t data) {
+    return (uint8_t)(data >> 58);
+}
+
+static inline TTBucket* bucketFor(const TransTable* tt, uint64_t key) {
+    return &tt->buckets[(uint64_t)(((unsigned __int128)key * tt->bucketCount) >> 64)];
+}
+
+/**
+ * ttResize - (re)allocates the table to @sizeMb megabytes and clears it.
+ * Large tables are 2 MB aligned and, on Linux, advised for transparent
+ * huge pages so multi-GB tables do not thrash the TLB.
+ *
+ * Return: true on success, false if the allocation failed (the table is
+ *         then empty and probes miss)
+ */
+bool ttResize(TransTable* tt, size_t sizeMb) {
+    size_t bytes = sizeMb * 1024 * 1024;
+    size_t alignment = (bytes >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : sizeof(TTBucket);
+    void* memory = NULL;
+
+    ttFree(tt);
+    if (sizeMb == 0) return true;
+
+    bytes -= bytes % sizeof(TTBucket);
+    if (posix_memalign(&memory, alignment, bytes) != 0) return false;
+#ifdef MADV_HUGEPAGE
+    madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+
+    tt->buckets = memory;
+    tt->bucketCount = bytes / sizeof(TTBucket);
+    tt->sizeMb = sizeMb;
+    ttClear(tt);
+    return true;
+}
+
+void ttFree(TransTable* tt) {
+    free(tt->buckets);
+    tt->buckets = NULL;
+    tt->bucketCount = 0;
+    tt->sizeMb = 0;
+    tt->generation = 0;
+}
+
+void ttClear(TransTable* tt) {
+    if (tt->buckets) {
+        memset(tt->buckets, 0, tt->bucketCount * sizeof(TTBucket));
+    }
+    tt->generation = 0;
+}
+
+/**
+ * ttNewSearch - starts a new generation. Entries are stamped with the
+ * generation that stored them and nothing is rewritten here; ttStore
+ * works out an entry's age from the stamp when it picks a slot to
+ * replace, so leftovers from earlier searches go first
+ */
+void ttNewSearch(TransTable* tt) {
+    tt->generation = (tt->generation + 1) & GENERATION_MASK;
+}
+
+bool ttProbe(const TransTable* tt, uint64_t key, TTData* data) {
+    if (!tt->buckets) return false;
+
+    TTBucket* bucket = bucketFor(tt, key);
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        TTEntry* entry = &bucket->entries[i];
+        uint64_t word = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&entry->keyXorData, __ATOMIC_RELAXED);
+
+        if ((check ^ word) == key && word != 0) {
+            data->move = (Move)(word & 0xFFFF);
+            data->score = (int16_t)((word >> 16) & 0xFFFF);
+            data->eval = (int16_t)((word >> 32) & 0xFFFF);
+            data->depth = (uint8_t)dataDepth(word);
+            data->bound = dataBound(word);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * ttStore - saves a search result. An entry for the same key is updated
+ * unless it holds a much deeper result from this search; otherwise the
+ * shallowest, oldest entry of the bucket is replaced.
+ */
+void ttStore(TransTable* tt, uint64_t key, Move move, int score, int eval, int depth, Bound bound) {
+    if (!tt->buckets) return;
+
+    TTBucket* bucket = bucketFor(tt, key);
+    TTEntry* replace = NULL;
+    int worstValue = INT_MAX;
+
+    if (depth < 0) depth = 0;
+    if (depth > 255) depth = 255;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        TTEntry* entry = &bucket->entries[i];
+        uint64_t word = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&entry->keyXorData, __ATOMIC_RELAXED);
+
+        if ((check ^ word) == key && word != 0) {
+            if (bound != BOUND_EXACT && dataGeneration(word) == tt->generation && depth + 2 < dataDepth(word)) {
+                return;
+            }
+            if (move == MOVE_NONE) move = (Move)(word & 0xFFFF);
+            replace = entry;
+            break;
+        }
+
+        int age = (tt->generation - dataGeneration(word)) & GENERATION_MASK;
+        int value = (word == 0) ? INT_MIN : dataDepth(word) - 8 * age;
+        if (value < worstValue) {
+            worstValue = value;
+            replace = entry;
+        }
+    }
+
+    uint64_t word = packData(move, score, eval, depth, bound, tt->generation);
+    __atomic_store_n(&replace->data, word, __ATOMIC_RELAXED);
+    __atomic_store_n(&replace->keyXorData, key ^ word, __ATOMIC_RELAXED);
+}
+
+/**
+ * ttHashfull - permille of sampled entries written by the current search
+ */
+int ttHashfull(const TransTable* tt) {
+    int used = 0, sampled = 0;
+
+    for (uint64_t b = 0; b < tt->bucketCount && sampled < 1000; ++b) {
+        for (int i = 0; i < TT_BUCKET_SIZE; ++i, ++sampled) {
+            uint64_t word = __atomic_load_n(&tt->buckets[b].entries[i].data, __ATOMIC_RELAXED);
+            used += word != 0 && dataGeneration(word) == tt->generation;
+        }
+    }
+    return sampled ? used * 1000 / sampled : 0;
+}
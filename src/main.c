@@ -1,398 +1,623 @@
+#include <string.h>
 #include "main.h"
 
 void initializeBoard(GameState* state) {
-    for (int row = 0; row < BOARD_SIZE; ++row) {
-        for (int col = 0; col < BOARD_SIZE; ++col) {
-            state->board[row][col].row = row;
-            state->board[row][col].col = col;
-            state->board[row][col].occupied = NOT_OCCUPIED;
-
-            state->board[row][col].rect.x = col * SQUARE_SIZE;
-            state->board[row][col].rect.y = row * SQUARE_SIZE;
-            state->board[row][col].rect.w = SQUARE_SIZE;
-            state->board[row][col].rect.h = SQUARE_SIZE;
-        }
-    }
+    positionClear(&state->position);
+    recordReset(&state->record, &state->position);
 }
 
-SDL_Texture* loadTexture(const char* file, SDL_Renderer* renderer) {
-    SDL_Surface* surface = SDL_LoadBMP(file);
+static SDL_Rect squareRect(int row, int col) {
+    SDL_Rect rect = {col * SQUARE_SIZE, row * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+    return rect;
+}
+
+/**
+ * loadPieceAtlas - uploads the sprite atlas compiled into the binary as
+ * one texture, so startup reads no files and the whole board is drawn
+ * from a single texture
+ */
+SDL_Texture* loadPieceAtlas(SDL_Renderer* renderer) {
+    SDL_RWops* stream = SDL_RWFromConstMem(pieceAtlasBmp, (int)pieceAtlasBmp_size);
+    SDL_Surface* surface = stream ? SDL_LoadBMP_RW(stream, 1) : NULL;
+    SDL_Texture* texture;
+
     if (!surface) {
-        fprintf(stderr, "Could not load image %s! SDL_Error: %s\n", file, SDL_GetError());
+        fprintf(stderr, "Could not decode the piece atlas! SDL_Error: %s\n", SDL_GetError());
         return NULL;
     }
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
     SDL_FreeSurface(surface);
+    if (texture) SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
     return texture;
 }
 
-void loadPieceTextures(GameState* state) {
-    state->white_pawn = loadTexture("assets/white_pawn.bmp", state->renderer); // white_pawn
-    state->white_knight = loadTexture("assets/white_knight.bmp", state->renderer); // white_knight
-    state->white_bishop = loadTexture("assets/white_bishop.bmp", state->renderer); // white_bishop
-    state->white_rook = loadTexture("assets/white_rook.bmp", state->renderer); // white_rook
-    state->white_queen = loadTexture("assets/white_queen.bmp", state->renderer); // white_queen
-    state->white_king = loadTexture("assets/white_king.bmp", state->renderer); // white_king
-    state->black_pawn = loadTexture("assets/black_pawn.bmp", state->renderer); // black_pawn
-    state->black_knight = loadTexture("assets/black_knight.bmp", state->renderer); // black_knight
-    state->black_bishop = loadTexture("assets/black_bishop.bmp", state->renderer); // black_bishop
-    state->black_rook = loadTexture("assets/black_rook.bmp", state->renderer); // black_rook
-    state->black_queen = loadTexture("assets/black_queen.bmp", state->renderer); // black_queen
-    state->black_king = loadTexture("assets/black_king.bmp", state->renderer); // black_king
+/**
+ * atlasRect - where @piece sits in the atlas: white on the top row,
+ * black below, pawn to king from the left
+ */
+static SDL_Rect atlasRect(Piece piece) {
+    SDL_Rect rect = {(PIECE_TYPE(piece) - PAWN) * ATLAS_CELL, (PIECE_COLOR(piece) == BLACK) * ATLAS_CELL,
+                     ATLAS_CELL, ATLAS_CELL};
+    return rect;
 }
 
 void initializePieces(GameState* state) {
-    for (int col = 0; col < BOARD_SIZE; ++col) {
-        state->board[1][col].piece.type = PAWN;
-        state->board[1][col].piece.color = WHITE;
-        state->board[1][col].piece.texture = state->white_pawn;
-
-        state->board[6][col].piece.type = PAWN;
-        state->board[6][col].piece.color = BLACK;
-        state->board[6][col].piece.texture = state->black_pawn;
-    }
-
-    PieceType backRank[] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
-    SDL_Texture* whiteTextures[] = {
-        state->white_rook, state->white_knight, state->white_bishop,
-        state->white_queen, state->white_king, state->white_bishop,
-        state->white_knight, state->white_rook
-    };
-    SDL_Texture* blackTextures[] = {
-        state->black_rook, state->black_knight, state->black_bishop,
-        state->black_queen, state->black_king, state->black_bishop,
-        state->black_knight, state->black_rook
-    };
+    positionSetStart(&state->position);
+    recordReset(&state->record, &state->position);
+}
 
-    for (int col = 0; col < BOARD_SIZE; ++col) {
-        state->board[0][col].piece.type = backRank[col];
-        state->board[0][col].piece.color = WHITE;
-        state->board[0][col].piece.texture = whiteTextures[col];
+/**
+ * loadFen - replaces the game with the position in @fen and forgets
+ * the move history
+ *
+ * Return: SDL_FALSE (and the game left untouched) on a malformed FEN
+ */
+SDL_bool loadFen(GameState* state, const char* fen) {
+    Position pos;
 
-        state->board[7][col].piece.type = backRank[col];
-        state->board[7][col].piece.color = BLACK;
-        state->board[7][col].piece.texture = blackTextures[col];
+    if (!positionSetFen(&pos, fen)) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        return SDL_FALSE;
     }
+    state->position = pos;
+    recordReset(&state->record, &pos);
+    state->playerState.pieceSelected = SDL_FALSE;
+    return SDL_TRUE;
 }
 
-void drawBoard(GameState* state) {
-    SDL_Color lightSquare = {240, 217, 181, 255};
-    SDL_Color darkSquare = {181, 136, 99, 255};
-    SDL_Color selectedSquare = {255, 255, 0, 255};
-    SDL_Color possibleMoveSquare = {173, 216, 230, 255};
-    SDL_Color checkSquare = {255, 0, 0, 255};
-    SDL_Color capturableSquare = {255, 69, 0, 255};
-
-    for (int row = 0; row < BOARD_SIZE; ++row) {
-        for (int col = 0; col < BOARD_SIZE; ++col) {
-            SDL_Color squareColor = ((row + col) % 2 == 0) ? lightSquare : darkSquare;
-
-            if (state->playerState.pieceSelected && state->playerState.selectedRow == row && state->playerState.selectedCol == col) {
-                squareColor = selectedSquare;
-            }
-
-            if (state->playerState.pieceSelected && validateMove(state, state->playerState.selectedRow, state->playerState.selectedCol, row, col)) {
-                if (state->board[row][col].piece.type != EMPTY && state->board[row][col].piece.color != state->playerState.selectedPiece->color) {
-                    squareColor = capturableSquare;
-                } else {
-                    squareColor = possibleMoveSquare;
-                }
-            }
+/**
+ * saveFen - prints the current position as FEN and copies it to the
+ * clipboard
+ */
+void saveFen(GameState* state) {
+    char fen[FEN_MAX];
 
-            if (state->board[row][col].piece.type == KING && isKingInCheck(state, state->board[row][col].piece.color)) {
-                squareColor = checkSquare;
-            }
+    positionToFen(&state->position, fen);
+    printf("%s\n", fen);
+    SDL_SetClipboardText(fen);
+}
 
-            SDL_SetRenderDrawColor(state->renderer, squareColor.r, squareColor.g, squareColor.b, squareColor.a);
-            SDL_RenderFillRect(state->renderer, &state->board[row][col].rect);
-            SDL_SetRenderDrawColor(state->renderer, 255, 255, 255, 255);
-            SDL_RenderDrawRect(state->renderer, &state->board[row][col].rect);
-
-            if (state->board[row][col].piece.type != EMPTY) {
-                SDL_RenderCopy(
-                    state->renderer,
-                    state->board[row][col].piece.texture,
-                    NULL,
-                    &state->board[row][col].rect
-                );
-            }
+/**
+ * loadPgn - replaces the game with the first game in @file, played
+ * through to its end so undo steps back through it; a game with an
+ * illegal move is loaded up to that move
+ *
+ * Return: SDL_FALSE (and the game left untouched) if @file holds no game
+ */
+SDL_bool loadPgn(GameState* state, FILE* file) {
+    PgnReader reader;
+    PgnGame game;
+    SDL_bool loaded = SDL_FALSE;
+
+    if (!pgnReaderOpen(&reader, file)) return SDL_FALSE;
+    pgnGameInit(&game);
+    if (pgnRead(&reader, &game)) {
+        if (game.error[0]) fprintf(stderr, "PGN %s, loaded up to there\n", game.error);
+        state->position = game.start;
+        recordReset(&state->record, &game.start);
+        for (int i = 0; i < game.moveCount; ++i) {
+            if (!recordPlay(&state->record, &state->position, game.moves[i])) break;
         }
+        state->playerState.pieceSelected = SDL_FALSE;
+        loaded = SDL_TRUE;
+    } else {
+        fprintf(stderr, "No PGN game found\n");
     }
+    pgnGameFree(&game);
+    pgnReaderClose(&reader);
+    return loaded;
 }
 
-SDL_bool validatePawnMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    Piece* piece = &state->board[fromRow][fromCol].piece;
-    int direction = (piece->color == WHITE) ? 1 : -1;
-    int startRow = (piece->color == WHITE) ? 1 : 6;
-
-    if (fromCol == toCol) {
-        if (toRow == fromRow + direction && state->board[toRow][toCol].piece.type == EMPTY) {
-            return SDL_TRUE;
-        }
-
-        if (fromRow == startRow && toRow == fromRow + 2 * direction && state->board[toRow][toCol].piece.type == EMPTY && state->board[fromRow + direction][toCol].piece.type == EMPTY) {
-            return SDL_TRUE;
-        }
+/**
+ * savePgn - prints the moves played so far as a PGN game and copies it
+ * to the clipboard
+ */
+void savePgn(GameState* state) {
+    const Position* pos = &state->position;
+    PgnGame game;
+    char* text = NULL;
+    size_t size = 0;
+    FILE* out;
+
+    pgnGameInit(&game);
+    pgnGameReset(&game, &state->record.start);
+    for (int i = 0; i < state->record.ply; ++i) {
+        pgnGameAddMove(&game, recordMove(&state->record, i));
     }
-
-    if (abs(fromCol - toCol) == 1 && toRow == fromRow + direction && state->board[toRow][toCol].piece.type != EMPTY && state->board[toRow][toCol].piece.color != piece->color) {
-        return SDL_TRUE;
+    if (positionIsCheckMate(pos)) {
+        strcpy(game.result, pos->sideToMove == WHITE ? "0-1" : "1-0");
+    } else if (positionIsStaleMate(pos) || positionIsDraw(pos, 0)) {
+        strcpy(game.result, "1/2-1/2");
     }
 
-    return SDL_FALSE;
+    if ((out = open_memstream(&text, &size))) {
+        pgnWrite(out, &game);
+        fclose(out);
+        printf("%s", text);
+        SDL_SetClipboardText(text);
+        free(text);
+    }
+    pgnGameFree(&game);
 }
 
-SDL_bool validateRookMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    if (fromRow != toRow && fromCol != toCol) return SDL_FALSE;
-    int stepRow = 0;
-    int stepCol = 0;
-
-    if (toRow - fromRow != 0) {
-        stepRow = (toRow - fromRow) / abs(toRow - fromRow);
-    }
-    if (toCol - fromCol != 0) {
-        stepCol = (toCol - fromCol) / abs(toCol - fromCol);
-    }
+typedef enum {
+    LOOK_PLAIN, LOOK_SELECTED, LOOK_TARGET, LOOK_CAPTURE, LOOK_CHECK
+} SquareLook;
 
-    for (int i = fromRow + stepRow, j = fromCol + stepCol; i != toRow || j != toCol; i += stepRow, j+= stepCol) {
-        if (state->board[i][j].piece.type != EMPTY) {
-            return SDL_FALSE;
+/**
+ * updateHighlights - recomputes the legal targets of the selected piece
+ * and the checked king, but only when the position or the selection
+ * changed since the last call
+ */
+void updateHighlights(GameState* state) {
+    const Position* pos = &state->position;
+    int from = state->playerState.pieceSelected
+             ? SQUARE(state->playerState.selectedRow, state->playerState.selectedCol) : SQUARE_NONE;
+
+    if (pos->key == state->highlightKey && from == state->highlightFrom) return;
+    state->highlightKey = pos->key;
+    state->highlightFrom = from;
+
+    state->moveTargets = 0;
+    if (from != SQUARE_NONE) {
+        MoveList list;
+
+        generateLegalMoves(pos, &list);
+        for (int i = 0; i < list.count; ++i) {
+            if (MOVE_FROM(list.moves[i]) == from) {
+                state->moveTargets |= SQUARE_BB(MOVE_TO(list.moves[i]));
+            }
         }
     }
-
-    return SDL_TRUE;
+    state->checkSquare = positionInCheck(pos, pos->sideToMove) ? pos->kingSquare[pos->sideToMove] : SQUARE_NONE;
 }
 
-SDL_bool validateKnightMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    int rowDiff = abs(fromRow - toRow);
-    int colDiff = abs(fromCol - toCol);
+/* What a square should show: its piece in the low byte, the highlight above */
+static uint32_t squareLook(const GameState* state, int square) {
+    Piece piece = state->position.board[square];
+    SquareLook look = LOOK_PLAIN;
 
-    if ((rowDiff == 2 && colDiff == 1) || (rowDiff == 1 && colDiff == 2)) {
-        return SDL_TRUE;
-    }
-    return SDL_FALSE;
+    if (square == state->highlightFrom) look = LOOK_SELECTED;
+    if (state->moveTargets & SQUARE_BB(square)) look = (piece != EMPTY) ? LOOK_CAPTURE : LOOK_TARGET;
+    if (square == state->checkSquare) look = LOOK_CHECK;
+    return (uint32_t)look << 8 | piece;
 }
 
-SDL_bool validateBishopMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    if (abs(fromRow - toRow) != abs(fromCol - toCol)) return SDL_FALSE;
+static void paintSquare(GameState* state, int row, int col, uint32_t look) {
+    static const SDL_Color colors[] = {
+        [LOOK_SELECTED] = {255, 255, 0, 255},
+        [LOOK_TARGET] = {173, 216, 230, 255},
+        [LOOK_CAPTURE] = {255, 69, 0, 255},
+        [LOOK_CHECK] = {255, 0, 0, 255},
+    };
+    SDL_Color lightSquare = {240, 217, 181, 255};
+    SDL_Color darkSquare = {181, 136, 99, 255};
+    SDL_Color squareColor = ((row + col) % 2 == 0) ? lightSquare : darkSquare;
+    SDL_Rect rect = squareRect(row, col);
+    Piece piece = (Piece)(look & 0xFF);
 
-    int stepRow = (toRow - fromRow != 0) ? (toRow - fromRow) / abs(toRow - fromRow) : 0;
-    int stepCol = (toCol - fromCol != 0) ? (toCol - fromCol) / abs(toCol - fromCol) : 0;
+    if ((look >> 8) != LOOK_PLAIN) squareColor = colors[look >> 8];
 
-    for (int i = fromRow + stepRow, j = fromCol + stepCol; i != toRow || j != toCol; i += stepRow, j += stepCol) {
-        if (state->board[i][j].piece.type != EMPTY) return SDL_FALSE;
+    SDL_SetRenderDrawColor(state->renderer, squareColor.r, squareColor.g, squareColor.b, squareColor.a);
+    SDL_RenderFillRect(state->renderer, &rect);
+    SDL_SetRenderDrawColor(state->renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(state->renderer, &rect);
+
+    if (piece != EMPTY) {
+        SDL_Rect source = atlasRect(piece);
+
+        SDL_RenderCopy(state->renderer, state->pieceAtlas, &source, &rect);
     }
-    return SDL_TRUE;
 }
 
-SDL_bool validateQueenMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    return validateRookMove(state, fromRow, fromCol, toRow, toCol) || validateBishopMove(state, fromRow, fromCol, toRow, toCol);
-}
+/**
+ * drawBoard - repaints the squares whose look changed since they were
+ * last drawn and presents the frame; does nothing when no square
+ * changed and the window needs no refresh
+ */
+void drawBoard(GameState* state) {
+    SDL_bool changed = SDL_FALSE;
 
-SDL_bool validateKingMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    int rowDiff = abs(fromRow - toRow);
-    int colDiff = abs(fromCol - toCol);
+    updateHighlights(state);
+    if (state->boardTexture) {
+        SDL_SetRenderTarget(state->renderer, state->boardTexture);
+    } else {
+        /* The window's back buffer is not kept between frames, so
+         * without a target texture any change repaints every square */
+        for (int square = 0; square < SQUARE_NB && !changed; ++square) {
+            changed = squareLook(state, square) != state->drawn[square];
+        }
+        if (!changed && !state->needsPresent) return;
+        memset(state->drawn, 0xFF, sizeof(state->drawn));
+    }
 
-    if (rowDiff <= 1 && colDiff <= 1) {
-        return SDL_TRUE;
+    for (int row = 0; row < BOARD_SIZE; ++row) {
+        for (int col = 0; col < BOARD_SIZE; ++col) {
+            uint32_t look = squareLook(state, SQUARE(row, col));
+
+            if (look == state->drawn[SQUARE(row, col)]) continue;
+            paintSquare(state, row, col, look);
+            state->drawn[SQUARE(row, col)] = look;
+            changed = SDL_TRUE;
+        }
     }
-    return SDL_FALSE;
+
+    if (state->boardTexture) SDL_SetRenderTarget(state->renderer, NULL);
+    if (!changed && !state->needsPresent) return;
+    if (state->boardTexture) SDL_RenderCopy(state->renderer, state->boardTexture, NULL, NULL);
+    SDL_RenderPresent(state->renderer);
+    state->needsPresent = SDL_FALSE;
 }
 
 SDL_bool validateMove(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    Piece* piece = &state->board[fromRow][fromCol].piece;
-
     if (toRow < 0 || toRow >= BOARD_SIZE || toCol < 0 || toCol >= BOARD_SIZE) return SDL_FALSE;
-    if (fromRow == toRow && fromCol == toCol) return SDL_FALSE;
 
-    if (state->board[toRow][toCol].piece.type != EMPTY && state->board[toRow][toCol].piece.color == piece->color) {
-        return SDL_FALSE;
-    }
+    return positionIsLegalMove(&state->position, SQUARE(fromRow, fromCol), SQUARE(toRow, toCol)) ? SDL_TRUE : SDL_FALSE;
+}
 
-    SDL_bool validMove = SDL_FALSE;
-    switch(piece->type) {
-        case PAWN:
-            validMove = validatePawnMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        case ROOK:
-            validMove = validateRookMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        case KNIGHT:
-            validMove = validateKnightMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        case BISHOP:
-            validMove = validateBishopMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        case QUEEN:
-            validMove = validateQueenMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        case KING:
-            validMove = validateKingMove(state, fromRow, fromCol, toRow, toCol);
-            break;
-        default:
-            return SDL_FALSE;
+/**
+ * playMove - makes @move and pushes it on the undo stack; the stack
+ * entries hold the undo records of the game's key chain
+ */
+static void playMove(GameState* state, Move move) {
+    if (!recordPlay(&state->record, &state->position, move)) {
+        fprintf(stderr, "Out of memory, move not played\n");
     }
+}
 
-    if (!validMove) return SDL_FALSE;
+/* Moves from the board; pawns reaching the last row become queens */
+void movePiece(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
+    Move move = positionFindMove(&state->position, SQUARE(fromRow, fromCol), SQUARE(toRow, toCol), QUEEN);
 
-    Piece tempPiece = state->board[toRow][toCol].piece;
-    state->board[toRow][toCol].piece = *piece;
-    state->board[fromRow][fromCol].piece.type = EMPTY;
-    state->board[fromRow][fromCol].piece.color = NONE;
-    state->board[fromRow][fromCol].piece.texture = NULL;
+    if (move != MOVE_NONE) playMove(state, move);
+}
 
-    SDL_bool kingStillInCheck = isKingInCheck(state, piece->color);
+void undoMove(GameState* state) {
+    recordUndo(&state->record, &state->position);
+}
 
-    state->board[fromRow][fromCol].piece = state->board[toRow][toCol].piece;
-    state->board[toRow][toCol].piece = tempPiece;
+void redoMove(GameState* state) {
+    recordRedo(&state->record, &state->position);
+}
 
-    if (kingStillInCheck) {
-        return SDL_FALSE;
+/**
+ * stepGame - undo, or redo with @forward, for the player at the board:
+ * a move that would leave the engine to move (its reply taken back
+ * while it ponders, say) is stepped over too, and if the engine is
+ * still to move after that it is asked for a move again
+ */
+static void stepGame(GameState* state, SDL_bool forward) {
+    engineCancel(state);
+    if (forward) redoMove(state);
+    else undoMove(state);
+
+    if (state->position.sideToMove == state->engineColor) {
+        if (forward) redoMove(state);
+        else undoMove(state);
     }
-
-    return SDL_TRUE;
+    if (state->gameIsActive && state->position.sideToMove == state->engineColor) engineMove(state);
 }
 
-void movePiece(GameState* state, int fromRow, int fromCol, int toRow, int toCol) {
-    Move move;
-    move.movedPiece = state->board[fromRow][fromCol].piece;
-    move.fromRow = fromRow;
-    move.fromCol = fromCol;
-    move.toRow = toRow;
-    move.toCol = toCol;
-    move.capturedPiece = state->board[toRow][toCol].piece;
-
-    state->undoStack[state->undoIndex++] = move;
-    state->redoIndex = 0;
+SDL_bool isKingInCheck(GameState* state, PieceColor color) {
+    return positionInCheck(&state->position, color) ? SDL_TRUE : SDL_FALSE;
+}
 
-    state->board[toRow][toCol].piece = state->board[fromRow][fromCol].piece;
-    state->board[toRow][toCol].occupied = OCCUPIED;
+SDL_bool isCheckMate(GameState* state, PieceColor color) {
+    if (color != state->position.sideToMove) return SDL_FALSE;
+    return positionIsCheckMate(&state->position) ? SDL_TRUE : SDL_FALSE;
+}
 
-    state->board[fromRow][fromCol].piece.type = EMPTY;
-    state->board[fromRow][fromCol].piece.color = NONE;
-    state->board[fromRow][fromCol].piece.texture = NULL;
-    state->board[fromRow][fromCol].occupied = NOT_OCCUPIED;
+void announceGameStatus(GameState* state) {
+    PieceColor turn = state->position.sideToMove;
+
+    if (isCheckMate(state, turn)) {
+        printf("Checkmate! %s is in checkmate!\n", (turn == WHITE) ? "White" : "Black");
+        state->gameIsActive = SDL_FALSE;
+    } else if (positionIsStaleMate(&state->position)) {
+        printf("Stalemate! %s has no legal move.\n", (turn == WHITE) ? "White" : "Black");
+        state->gameIsActive = SDL_FALSE;
+    } else if (positionIsDraw(&state->position, 0)) {
+        printf("Draw by %s!\n", (state->position.rule50 >= 100) ? "the fifty-move rule" : "threefold repetition");
+        state->gameIsActive = SDL_FALSE;
+    } else if (isKingInCheck(state, turn)) {
+        printf("Check! %s is in check!\n", (turn == WHITE) ? "White" : "Black");
+    }
 }
 
-void undoMove(GameState* state) {
-    if (state->undoIndex == 0) return;
+/**
+ * postReply - hands a finished search to the event loop
+ */
+static void postReply(EngineWorker* engine, int generation, Move best, Move reply) {
+    SDL_Event event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = engine->eventType;
+    event.user.code = generation;
+    event.user.data1 = (void*)(intptr_t)best;
+    event.user.data2 = (void*)(intptr_t)reply;
+    SDL_PushEvent(&event);
+}
 
-    Move move = state->undoStack[--state->undoIndex];
-    state->redoStack[state->redoIndex++] = move;
+/* Called by the search after every iteration, on the engine thread.
+ * searchRun drops a stop that came before it started, so a job that
+ * went stale in that window is stopped here */
+static void engineIteration(const SearchInfo* info, void* data) {
+    EngineWorker* engine = data;
 
-    state->board[move.fromRow][move.fromCol].piece = move.movedPiece;
-    state->board[move.toRow][move.toCol].piece = move.capturedPiece;
+    (void)info;
+    SDL_LockMutex(engine->lock);
+    if (engine->searchGeneration != engine->generation) searchStop(engine->search);
+    SDL_UnlockMutex(engine->lock);
 }
 
-void redoMove(GameState* state) {
-    if (state->redoIndex == 0) return;
-
-    Move move = state->redoStack[--state->redoIndex];
-    state->undoStack[state->undoIndex++] = move;
+/**
+ * engineMain - the engine thread: takes the newest job, searches it with
+ * the lock released and reports back unless the job went stale in the
+ * meantime. A ponder search that ends by itself keeps its answer for
+ * engineMove.
+ */
+static int engineMain(void* data) {
+    EngineWorker* engine = data;
+    GameRecord record;
+    Position pos;
+
+    positionSetStart(&pos);
+    recordInit(&record, &pos);
+
+    SDL_LockMutex(engine->lock);
+    for (;;) {
+        SearchLimits limits = {0};
+        SearchInfo info;
+        int generation;
+        Move best;
+
+        while (!engine->pending) SDL_CondWait(engine->wake, engine->lock);
+        if (engine->job == ENGINE_QUIT) break;
+
+        /* The search follows the undo chain for repetitions, so it gets
+         * a record of its own that the board cannot change under it */
+        pos = engine->start;
+        pos.history = NULL;
+        recordReset(&record, &pos);
+        for (int i = 0; i < engine->moveCount; ++i) recordPlay(&record, &pos, engine->moves[i]);
+
+        if (engine->job == ENGINE_THINK) {
+            limits.moveTime = ENGINE_MOVE_TIME;
+        } else {
+            limits.infinite = true;
+        }
+        generation = engine->generation;
+        engine->pending = SDL_FALSE;
+        engine->busy = SDL_TRUE;
+        engine->searchGeneration = generation;
+        SDL_UnlockMutex(engine->lock);
+
+        best = searchRun(engine->search, &pos, &limits, &info);
+
+        SDL_LockMutex(engine->lock);
+        engine->busy = SDL_FALSE;
+        if (generation != engine->generation) continue;
+
+        if (engine->job == ENGINE_THINK) {
+            postReply(engine, generation, best, info.pvLength > 1 ? info.pv[1] : MOVE_NONE);
+            engine->job = ENGINE_IDLE;
+        } else {
+            engine->ponderDone = SDL_TRUE;
+            engine->ponderBest = best;
+            engine->ponderReply = info.pvLength > 1 ? info.pv[1] : MOVE_NONE;
+        }
+    }
+    SDL_UnlockMutex(engine->lock);
 
-    state->board[move.toRow][move.toCol].piece = move.movedPiece;
-    state->board[move.fromRow][move.fromCol].piece.type = EMPTY;
-    state->board[move.fromRow][move.fromCol].piece.color = NONE;
-    state->board[move.fromRow][move.fromCol].piece.texture = NULL;
+    recordFree(&record);
+    return 0;
 }
 
-SDL_bool isKingInCheck(GameState* state, PieceColor color) {
-    int kingRow = -1, kingCol = -1;
+/* Ends the search a ponder hit turned into the engine's move, once its
+ * share of ENGINE_MOVE_TIME is used up; runs on SDL's timer thread */
+static Uint32 stopTimerFired(Uint32 interval, void* data) {
+    EngineWorker* engine = data;
 
-    for (int row = 0; row < BOARD_SIZE; ++row) {
-        for (int col = 0; col < BOARD_SIZE; ++col) {
-            Piece* piece = &state->board[row][col].piece;
-            if (piece->type == KING && piece->color == color) {
-                kingRow = row;
-                kingCol = col;
-                break;
-            }
-        }
+    (void)interval;
+    SDL_LockMutex(engine->lock);
+    if (engine->timerGeneration == engine->generation) {
+        if (engine->busy) searchStop(engine->search);
+        engine->stopTimer = 0;
     }
+    SDL_UnlockMutex(engine->lock);
+    return 0;
+}
 
-    for (int row = 0; row < BOARD_SIZE; ++row) {
-        for (int col = 0; col < BOARD_SIZE; ++col) {
-            Piece* piece = &state->board[row][col].piece;
-            if (piece->color != color && piece->type != EMPTY) {
-                if (validateMove(state, row, col, kingRow, kingCol)) {
-                    return SDL_TRUE;
-                }
-            }
-        }
-    }
-    return SDL_FALSE;
+/**
+ * engineStart - starts the engine thread on @state's search
+ *
+ * Return: SDL_FALSE if it could not be started
+ */
+SDL_bool engineStart(GameState* state) {
+    EngineWorker* engine = &state->engine;
+
+    engine->search = state->search;
+    engine->search->onIteration = engineIteration;
+    engine->search->userData = engine;
+    engine->eventType = SDL_RegisterEvents(1);
+    if (engine->eventType == (Uint32)-1) return SDL_FALSE;
+    if (!(engine->lock = SDL_CreateMutex()) || !(engine->wake = SDL_CreateCond())) return SDL_FALSE;
+
+    engine->thread = SDL_CreateThreadWithStackSize(engineMain, "engine", ENGINE_STACK_SIZE, engine);
+    return engine->thread ? SDL_TRUE : SDL_FALSE;
 }
 
-SDL_bool isCheckMate(GameState* state, PieceColor color) {
-    if (!isKingInCheck(state, color)) {
-        return SDL_FALSE;
+/**
+ * engineQuit - stops whatever the engine thread is doing and waits for
+ * it to exit
+ */
+void engineQuit(GameState* state) {
+    EngineWorker* engine = &state->engine;
+
+    if (engine->thread) {
+        SDL_LockMutex(engine->lock);
+        if (engine->busy) searchStop(engine->search);
+        if (engine->stopTimer) SDL_RemoveTimer(engine->stopTimer);
+        engine->generation++;
+        engine->job = ENGINE_QUIT;
+        engine->pending = SDL_TRUE;
+        SDL_CondSignal(engine->wake);
+        SDL_UnlockMutex(engine->lock);
+        SDL_WaitThread(engine->thread, NULL);
+        engine->thread = NULL;
     }
+    if (engine->wake) SDL_DestroyCond(engine->wake);
+    if (engine->lock) SDL_DestroyMutex(engine->lock);
+    free(engine->moves);
+}
 
-    for (int fromRow = 0; fromRow < BOARD_SIZE; ++fromRow) {
-        for (int fromCol = 0; fromCol < BOARD_SIZE; ++fromCol) {
-            Piece* piece = &state->board[fromRow][fromCol].piece;
-            if (piece->color == color && piece->type != EMPTY) {
-                for (int toRow = 0; toRow < BOARD_SIZE; ++toRow) {
-                    for (int toCol = 0; toCol < BOARD_SIZE; ++toCol) {
-                        if (validateMove(state, fromRow, fromCol, toRow, toCol)) {
-                            Piece tempPiece = state->board[toRow][toCol].piece;
-                            state->board[toRow][toCol].piece = state->board[fromRow][toCol].piece;
-                            movePiece(state, fromRow, fromCol, toRow, toCol);
-
-                            SDL_bool stillInCheck = isKingInCheck(state, color);
+/**
+ * engineRequest - gives the engine thread a new job on the game as it
+ * stands, followed by @extra when pondering; whatever the thread was
+ * doing goes stale
+ */
+static void engineRequest(GameState* state, EngineJob job, Move extra) {
+    EngineWorker* engine = &state->engine;
+    int count = state->record.ply + (extra != MOVE_NONE);
+
+    SDL_LockMutex(engine->lock);
+    if (count > engine->moveCapacity) {
+        int capacity = (count < 256) ? 256 : count * 2;
+        Move* moves = realloc(engine->moves, (size_t)capacity * sizeof(Move));
+
+        if (!moves) {
+            SDL_UnlockMutex(engine->lock);
+            fprintf(stderr, "Out of memory, the engine cannot think\n");
+            return;
+        }
+        engine->moves = moves;
+        engine->moveCapacity = capacity;
+    }
+    if (engine->busy) searchStop(engine->search);
+
+    engine->start = state->record.start;
+    for (int i = 0; i < state->record.ply; ++i) engine->moves[i] = recordMove(&state->record, i);
+    if (extra != MOVE_NONE) engine->moves[state->record.ply] = extra;
+    engine->moveCount = count;
+    engine->job = job;
+    engine->generation++;
+    engine->pending = SDL_TRUE;
+    engine->ponderDone = SDL_FALSE;
+    SDL_CondSignal(engine->wake);
+    SDL_UnlockMutex(engine->lock);
+}
 
-                            state->board[fromRow][fromCol].piece = state->board[toRow][toCol].piece;
-                            state->board[toRow][toCol].piece = tempPiece;
+/**
+ * engineCancel - drops the engine's current job, so its answer (if any
+ * is still on the way) is ignored; does not wait for the search to end
+ */
+void engineCancel(GameState* state) {
+    EngineWorker* engine = &state->engine;
+
+    if (!engine->thread) return;
+    SDL_LockMutex(engine->lock);
+    if (engine->busy) searchStop(engine->search);
+    engine->generation++;
+    engine->job = ENGINE_IDLE;
+    engine->pending = SDL_FALSE;
+    engine->ponderDone = SDL_FALSE;
+    SDL_UnlockMutex(engine->lock);
+}
 
-                            if (!stillInCheck) {
-                                return SDL_FALSE;
-                            }
-                        }
-                    }
-                }
-            }
+/**
+ * engineMove - sets the engine to move and returns at once. A book move
+ * is played straight away. If the engine was pondering on the move just
+ * played, that search carries on as the real one with the time it has
+ * already spent counted against ENGINE_MOVE_TIME; otherwise a fresh
+ * search starts. Its move arrives through handleEngineReply.
+ */
+void engineMove(GameState* state) {
+    EngineWorker* engine = &state->engine;
+    Move best = bookPick(&state->book, &state->position, &state->bookSeed);
+
+    if (best != MOVE_NONE) {
+        engineCancel(state);
+        playMove(state, best);
+        announceGameStatus(state);
+        return;
+    }
+    if (!engine->thread) return;
+
+    SDL_LockMutex(engine->lock);
+    if (engine->job == ENGINE_PONDER && !engine->pending && engine->ponderKey == state->position.key) {
+        Sint32 left = ENGINE_MOVE_TIME - (Sint32)(SDL_GetTicks() - engine->ponderStart);
+
+        engine->job = ENGINE_THINK;
+        if (engine->ponderDone) {
+            engine->job = ENGINE_IDLE;
+            postReply(engine, engine->generation, engine->ponderBest, engine->ponderReply);
+        } else if (left <= 0) {
+            searchStop(engine->search);
+        } else {
+            engine->timerGeneration = engine->generation;
+            if (engine->stopTimer) SDL_RemoveTimer(engine->stopTimer);
+            engine->stopTimer = SDL_AddTimer((Uint32)left, stopTimerFired, engine);
+            if (!engine->stopTimer) searchStop(engine->search);
         }
+        SDL_UnlockMutex(engine->lock);
+        return;
     }
-
-    return SDL_TRUE;
+    SDL_UnlockMutex(engine->lock);
+    engineRequest(state, ENGINE_THINK, MOVE_NONE);
 }
 
+/**
+ * handleEngineReply - plays the move of a finished search if it still
+ * answers the position on the board, then ponders on the reply the
+ * engine expects
+ */
+void handleEngineReply(GameState* state, const SDL_UserEvent* reply) {
+    EngineWorker* engine = &state->engine;
+    Move best = (Move)(intptr_t)reply->data1;
+    Move expected = (Move)(intptr_t)reply->data2;
+    Position next;
+    UndoInfo undo;
+    char text[6];
+
+    /* generation is only ever changed on this thread, no lock needed */
+    if (reply->code != engine->generation || best == MOVE_NONE) return;
+    if (!state->gameIsActive || state->position.sideToMove != state->engineColor) return;
+
+    playMove(state, best);
+    announceGameStatus(state);
+
+    if (!engine->ponder || !state->gameIsActive || expected == MOVE_NONE) return;
+    if (moveFromString(&state->position, moveToString(expected, text)) != expected) return;
+    next = state->position;
+    positionMakeMove(&next, expected, &undo);
+    engine->ponderKey = next.key;
+    engine->ponderStart = SDL_GetTicks();
+    engineRequest(state, ENGINE_PONDER, expected);
+}
 
 void handleMouseClick(GameState* state, int x, int y) {
     int col = x / SQUARE_SIZE;
     int row = y / SQUARE_SIZE;
+    PieceColor turn = state->position.sideToMove;
 
-    if (state->playerState.selectedPiece) {
-        if (
-            validateMove(
-                state,
-                state->playerState.selectedRow,
-                state->playerState.selectedCol,
-                row, col)
-        ) {
-            Piece tempPiece = state->board[row][col].piece;
-            movePiece(state, state->playerState.selectedRow, state->playerState.selectedCol, row, col);
+    if (row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE) return;
+    /* The engine is thinking on this side's move */
+    if (turn == state->engineColor) return;
 
-            if (isKingInCheck(state, state->currentTurn)) {
-                state->board[state->playerState.selectedRow][state->playerState.selectedCol].piece = state->board[row][col].piece;
-                state->board[row][col].piece = tempPiece;
-            } else {
-                state->currentTurn = (state->currentTurn == WHITE) ? BLACK : WHITE;
-
-                if (isCheckMate(state, state->currentTurn)) {
-                    printf("Checkmate! %s is in check!\n", (state->currentTurn == WHITE) ? "White" : "Black");
-                    state->gameIsActive = SDL_FALSE;
-                } else if (isKingInCheck(state, state->currentTurn)) {
-                    printf("Check! %s is in checkmate!\n", (state->currentTurn == WHITE) ? "White" : "Black");
-                }
+    updateHighlights(state);
+    if (state->playerState.pieceSelected) {
+        if (state->moveTargets & SQUARE_BB(SQUARE(row, col))) {
+            movePiece(state, state->playerState.selectedRow, state->playerState.selectedCol, row, col);
+            announceGameStatus(state);
 
+            if (state->gameIsActive && state->position.sideToMove == state->engineColor) {
+                engineMove(state);
             }
         }
-        state->playerState.selectedPiece = NULL;
         state->playerState.pieceSelected = SDL_FALSE;
     } else {
-        if (state->board[row][col].piece.type != EMPTY && state->board[row][col].piece.color == state->currentTurn) {
-            state->playerState.selectedPiece = &state->board[row][col].piece;
+        Piece piece = state->position.board[SQUARE(row, col)];
+        if (piece != EMPTY && PIECE_COLOR(piece) == turn) {
             state->playerState.selectedRow = row;
             state->playerState.selectedCol = col;
             state->playerState.pieceSelected = SDL_TRUE;
@@ -401,35 +626,114 @@ void handleMouseClick(GameState* state, int x, int y) {
 }
 
 
+/**
+ * handleEvents - sleeps until an event arrives, then handles it and
+ * everything else already queued, so the GUI costs nothing while idle
+ */
 void handleEvents(GameState* state) {
-    while (SDL_PollEvent(state->e)) {
+    if (!SDL_WaitEvent(state->e)) return;
+
+    do {
         if (state->e->type == SDL_QUIT) {
             state->gameIsActive = SDL_FALSE;
+        } else if (state->e->type == SDL_WINDOWEVENT) {
+            state->needsPresent = SDL_TRUE;
+        } else if (state->e->type == SDL_RENDER_TARGETS_RESET) {
+            /* The driver dropped boardTexture's contents: repaint it all */
+            memset(state->drawn, 0xFF, sizeof(state->drawn));
+        } else if (state->e->type == state->engine.eventType) {
+            handleEngineReply(state, &state->e->user);
         } else if(state->e->type == SDL_MOUSEBUTTONDOWN) {
             int x, y;
             SDL_GetMouseState(&x, &y);
             handleMouseClick(state, x, y);
         } else if (state->e->type == SDL_KEYDOWN) {
             if (state->e->key.keysym.sym == SDLK_z && (SDL_GetModState() & KMOD_CTRL)) {
-                // Ctrl + Z for undo
-                undoMove(state);
+                /* Ctrl + Z for undo */
+                stepGame(state, SDL_FALSE);
             } else if (state->e->key.keysym.sym == SDLK_y && (SDL_GetModState() & KMOD_CTRL)) {
-                // Ctrl + y for undo
-                redoMove(state);
+                /* Ctrl + Y for redo */
+                stepGame(state, SDL_TRUE);
+            } else if (state->e->key.keysym.sym == SDLK_c && (SDL_GetModState() & KMOD_CTRL)) {
+                /* Ctrl + C copies the position as FEN */
+                saveFen(state);
+            } else if (state->e->key.keysym.sym == SDLK_p && (SDL_GetModState() & KMOD_CTRL)) {
+                /* Ctrl + P copies the game as PGN */
+                savePgn(state);
+            } else if (state->e->key.keysym.sym == SDLK_v && (SDL_GetModState() & KMOD_CTRL)) {
+                /* Ctrl + V sets up the FEN, or replays the PGN game, on the clipboard */
+                char* text = SDL_GetClipboardText();
+                if (text) {
+                    FILE* pgn;
+
+                    engineCancel(state);
+                    /* FEN has no '.' or '[', PGN move numbers and tags do */
+                    if (!strpbrk(text, ".[")) {
+                        loadFen(state, text);
+                    } else if ((pgn = fmemopen(text, strlen(text), "r"))) {
+                        loadPgn(state, pgn);
+                        fclose(pgn);
+                    }
+                    SDL_free(text);
+                }
+            } else if (state->e->key.keysym.sym == SDLK_e) {
+                /* E hands the side to move to the engine (or takes it back) */
+                if (state->engineColor == state->position.sideToMove) {
+                    state->engineColor = NONE;
+                    engineCancel(state);
+                } else {
+                    state->engineColor = state->position.sideToMove;
+                    engineMove(state);
+                }
             }
         }
-    }
-
+    } while (SDL_PollEvent(state->e));
 }
 
 /**
  * main - Entry point
+ * @argc: argument count
+ * @argv: optional "--hash <MB>" and "--threads <N>" for the engine,
+ *        "--fen <FEN>" to start from a position, "--pgn <file>" to
+ *        replay the first game of a PGN file, "--book <file>" for a
+ *        Polyglot opening book, "--nnue <file>" to evaluate with a
+ *        network instead of the handcrafted terms, "--no-ponder" to
+ *        keep the engine idle on the human's time
  * 
  * Return: Always 0 (success)
  *         otherwise 1 (failure)
  */
-int main(void) {
-    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+int main(int argc, char** argv) {
+    size_t hashMb = TT_DEFAULT_MB;
+    int threads = 1;
+    const char* fen = NULL;
+    const char* book = NULL;
+    const char* pgn = NULL;
+    const char* network = NULL;
+    char bitbasePath[BITBASE_PATH_MAX];
+    SDL_bool ponder = SDL_TRUE;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-ponder") == 0) {
+            ponder = SDL_FALSE;
+        } else if (i + 1 == argc) {
+            break;
+        } else if (strcmp(argv[i], "--hash") == 0) {
+            hashMb = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fen") == 0) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--book") == 0) {
+            book = argv[++i];
+        } else if (strcmp(argv[i], "--pgn") == 0) {
+            pgn = argv[++i];
+        } else if (strcmp(argv[i], "--nnue") == 0) {
+            network = argv[++i];
+        }
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
         fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         return 1;
     }
@@ -462,26 +766,79 @@ int main(void) {
         return 1;
     }
 
+    state.search = calloc(1, sizeof(Search));
+    if (!state.search || !searchInit(state.search, threads)) {
+        fprintf(stderr, "Memory allocation for Search failed!\n");
+        free(state.search);
+        free(state.e);
+        SDL_DestroyRenderer(state.renderer);
+        SDL_DestroyWindow(state.window);
+        SDL_Quit();
+        return 1;
+    }
+
+    if (!ttResize(&state.tt, hashMb)) {
+        fprintf(stderr, "Could not allocate a %zu MB hash table, searching without one\n", hashMb);
+    }
+    state.search->tt = &state.tt;
+
     state.gameIsActive = SDL_TRUE;
-    state.currentTurn = WHITE;
+    state.engineColor = NONE;
 
-    loadPieceTextures(&state);
+    chessCoreInit();
+    if (!bitbaseDefaultPath(bitbasePath, sizeof(bitbasePath)) || !bitbaseInit(bitbasePath, threads)) {
+        fprintf(stderr, "Could not load or build the endgame bitbases, playing without them\n");
+    }
+    state.bookSeed = (uint64_t)SDL_GetTicks() | 1;
+    if (book && !bookOpen(&state.book, book)) {
+        fprintf(stderr, "Could not open opening book %s, playing without one\n", book);
+    }
+    if (network && !nnueLoad(network)) {
+        fprintf(stderr, "Could not load network %s, using the classic evaluation\n", network);
+    }
+    state.pieceAtlas = loadPieceAtlas(state.renderer);
+    if (SDL_RenderTargetSupported(state.renderer)) {
+        state.boardTexture = SDL_CreateTexture(state.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                               WINDOW_WIDTH, WINDOW_HEIGHT);
+    }
+    memset(state.drawn, 0xFF, sizeof(state.drawn));
+    state.highlightKey = ~(uint64_t)0;
+    state.needsPresent = SDL_TRUE;
     initializeBoard(&state);
     initializePieces(&state);
+    if (fen) loadFen(&state, fen);
+    if (pgn) {
+        FILE* file = fopen(pgn, "r");
+
+        if (file) {
+            loadPgn(&state, file);
+            fclose(file);
+        } else {
+            perror(pgn);
+        }
+    }
 
+    state.engine.ponder = ponder;
+    if (!engineStart(&state)) {
+        fprintf(stderr, "Could not start the engine thread, playing without the engine\n");
+    }
+
+    drawBoard(&state);
     while (state.gameIsActive) {
         handleEvents(&state);
-
-        SDL_SetRenderDrawColor(state.renderer, 255, 255, 255, 255);
-        SDL_RenderClear(state.renderer);
-
         drawBoard(&state);
-
-        SDL_RenderPresent(state.renderer);
-
-        SDL_Delay(16);
     }
 
+    engineQuit(&state);
+    if (state.boardTexture) SDL_DestroyTexture(state.boardTexture);
+    if (state.pieceAtlas) SDL_DestroyTexture(state.pieceAtlas);
+    ttFree(&state.tt);
+    recordFree(&state.record);
+    bookClose(&state.book);
+    bitbaseFree();
+    nnueFree();
+    searchFree(state.search);
+    free(state.search);
     free(state.e);
 
     SDL_DestroyRenderer(state.renderer);
@@ -0,0 +1,525 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bitbase.h"
+#include "misc.h"
+#include "search.h"
+#include "stats.h"
+
+#define BATCH_DEFAULT_DEPTH 8
+#define BATCH_DEFAULT_HASH_MB 8
+#define CHUNK_LINES 64          /** lines a worker claims at a time */
+#define WINDOW_PER_THREAD 4     /** finished chunks allowed to wait for the writer */
+#define LINE_MAX_LENGTH 512
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define SEARCH_STACK_SIZE (8 * 1024 * 1024)
+
+typedef enum {
+    FORMAT_CSV, FORMAT_JSON
+} OutputFormat;
+
+/**
+ * Buffer - growable text buffer; one chunk's formatted results
+ */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+/**
+ * Slot - a finished chunk parked until every earlier chunk is written
+ */
+typedef struct {
+    Buffer text;
+    bool ready;
+} Slot;
+
+/**
+ * Batch - the shared state. Workers claim chunks of lines from the
+ * mapped input in order, each chunk numbered; finished chunks go into
+ * the window and whoever completes the oldest one writes out the run
+ * that is now in order. A worker may not run further ahead of the
+ * writer than the window, so memory stays bounded however long the
+ * input is.
+ */
+typedef struct {
+    const char* input;
+    size_t inputSize;
+    size_t cursor;          /** next unclaimed byte */
+    uint64_t nextLine;      /** line number at the cursor, from 1 */
+    uint64_t nextChunk;
+    uint64_t nextWrite;     /** oldest chunk not yet written */
+
+    Slot* window;
+    size_t windowSize;
+    FILE* output;
+    OutputFormat format;
+
+    SearchLimits limits;
+    size_t hashMb;
+
+    uint64_t positions;
+    uint64_t errors;
+    uint64_t nodes;
+
+    pthread_mutex_t lock;
+    pthread_cond_t advanced;
+} Batch;
+
+typedef struct {
+    Batch* batch;
+    pthread_t handle;
+    bool started;
+} Worker;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options] input.epd\n"
+            "  --depth N      search each position to depth N (default %d)\n"
+            "  --nodes N      stop each search after N nodes instead\n"
+            "  --threads N    worker threads (default: all cores)\n"
+            "  --hash MB      transposition table per worker (default %d)\n"
+            "  --format F     csv or json (JSON Lines), default csv\n"
+            "  --output FILE  write results to FILE instead of stdout\n"
+            "  --stats        print the engine counters as JSON on stderr\n"
+            "                 (builds configured with -DCHESS_STATS=ON)\n"
+            "Lines are FEN or EPD; blank lines and '#' comments are skipped.\n"
+            "Endgame bitbases live in $%s, or ~/.cache/%s.\n"
+            "Exits with status 2 if any line could not be analysed.\n",
+            program, BATCH_DEFAULT_DEPTH, BATCH_DEFAULT_HASH_MB, BITBASE_PATH_ENV, BITBASE_CACHE_DIR);
+}
+
+static bool bufferReserve(Buffer* buffer, size_t extra) {
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    char* data;
+
+    if (buffer->length + extra <= buffer->capacity) return true;
+    while (capacity < buffer->length + extra) capacity *= 2;
+    if (!(data = realloc(buffer->data, capacity))) return false;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static void bufferPrintf(Buffer* buffer, const char* format, ...) {
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length < 0 || !bufferReserve(buffer, (size_t)length + 1)) return;
+
+    va_start(args, format);
+    vsnprintf(buffer->data + buffer->length, (size_t)length + 1, format, args);
+    va_end(args);
+    buffer->length += (size_t)length;
+}
+
+/**
+ * bufferQuoted - appends @text as a quoted CSV field or JSON string
+ */
+static void bufferQuoted(Buffer* buffer, const char* text, OutputFormat format) {
+    bufferPrintf(buffer, "\"");
+    for (const char* c = text; *c; ++c) {
+        if (format == FORMAT_CSV) {
+            bufferPrintf(buffer, (*c == '"') ? "\"\"" : "%c", *c);
+        } else if (*c == '"' || *c == '\\') {
+            bufferPrintf(buffer, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            bufferPrintf(buffer, "\\u%04x", (unsigned char)*c);
+        } else {
+            bufferPrintf(buffer, "%c", *c);
+        }
+    }
+    bufferPrintf(buffer, "\"");
+}
+
+/**
+ * findId - copies the value of the EPD "id" operation in @ops, if any
+ */
+static void findId(const char* ops, char* id, size_t size) {
+    const char* c = ops;
+    size_t length = 0;
+
+    id[0] = '\0';
+    while (c && (c = strstr(c, "id ")) != NULL) {
+        if (c == ops || c[-1] == ' ' || c[-1] == ';') break;
+        c += 3;
+    }
+    if (!c) return;
+
+    c += 3;
+    while (*c == ' ') c++;
+    if (*c == '"') {
+        for (c++; *c && *c != '"' && length + 1 < size; ++c) id[length++] = *c;
+    } else {
+        for (; *c && *c != ';' && *c != ' ' && length + 1 < size; ++c) id[length++] = *c;
+    }
+    id[length] = '\0';
+}
+
+/**
+ * parseLine - loads a FEN (clocks optional) or an EPD record
+ *
+ * Return: NULL on success, otherwise what was wrong with the line
+ */
+static const char* parseLine(Position* pos, const char* line, char* id, size_t idSize) {
+    const char* ops = positionSetEpd(pos, line);
+
+    id[0] = '\0';
+    if (!ops) return "malformed position";
+    if (isdigit((unsigned char)*ops)) {
+        if (!positionSetFen(pos, line)) return "malformed move clocks";
+    } else {
+        findId(ops, id, idSize);
+    }
+    if (positionInCheck(pos, OPPONENT(pos->sideToMove))) return "side not to move is in check";
+    return NULL;
+}
+
+static void writeHeader(Batch* batch) {
+    if (batch->format == FORMAT_CSV) {
+        fputs("line,fen,id,depth,cp,mate,bestmove,nodes,time_ms,pv,error\n", batch->output);
+    }
+}
+
+/**
+ * formatResult - one output record for the position on @line
+ */
+static void formatResult(Buffer* out, OutputFormat format, uint64_t line, const char* fen, const char* id,
+                         const SearchInfo* info, Move best, const char* error) {
+    char move[6], pv[MAX_PLY * 6 + 1] = "", score[24] = "";
+    bool csv = format == FORMAT_CSV;
+
+    if (!error) {
+        for (int i = 0; i < info->pvLength; ++i) {
+            if (i) strcat(pv, " ");
+            strcat(pv, moveToString(info->pv[i], move));
+        }
+        if (info->score >= VALUE_MATE_IN_MAX_PLY) {
+            snprintf(score, sizeof(score), csv ? ",%d" : "\"mate\":%d", (VALUE_MATE - info->score + 1) / 2);
+        } else if (info->score <= -VALUE_MATE_IN_MAX_PLY) {
+            snprintf(score, sizeof(score), csv ? ",%d" : "\"mate\":%d", -(VALUE_MATE + info->score) / 2);
+        } else {
+            snprintf(score, sizeof(score), csv ? "%d," : "\"cp\":%d", info->score);
+        }
+    }
+
+    bufferPrintf(out, csv ? "%llu," : "{\"line\":%llu,\"fen\":", (unsigned long long)line);
+    bufferQuoted(out, fen, format);
+    if (csv || *id) {
+        bufferPrintf(out, csv ? "," : ",\"id\":");
+        bufferQuoted(out, id, format);
+    }
+    if (error) {
+        bufferPrintf(out, csv ? ",,,,,,,," : ",\"error\":");
+        bufferQuoted(out, error, format);
+        bufferPrintf(out, csv ? "\n" : "}\n");
+        return;
+    }
+    bufferPrintf(out, csv ? ",%d,%s,%s,%llu,%lld," : ",\"depth\":%d,%s,\"bestmove\":\"%s\",\"nodes\":%llu,\"time_ms\":%lld,\"pv\":",
+                 info->depth, score, best == MOVE_NONE ? "" : moveToString(best, move),
+                 (unsigned long long)info->nodes, (long long)info->elapsedMs);
+    bufferQuoted(out, pv, format);
+    bufferPrintf(out, csv ? ",\n" : "}\n");
+}
+
+/**
+ * claimChunk - takes the next CHUNK_LINES lines of input, waiting while
+ * the writer is a full window behind
+ *
+ * Return: false once the input is exhausted
+ */
+static bool claimChunk(Batch* batch, uint64_t* chunk, size_t* begin, size_t* end, uint64_t* firstLine) {
+    const char* input = batch->input;
+    size_t cursor;
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->cursor < batch->inputSize && batch->nextChunk >= batch->nextWrite + batch->windowSize) {
+        pthread_cond_wait(&batch->advanced, &batch->lock);
+    }
+    if (batch->cursor >= batch->inputSize) {
+        pthread_mutex_unlock(&batch->lock);
+        return false;
+    }
+
+    cursor = *begin = batch->cursor;
+    *firstLine = batch->nextLine;
+    for (int lines = 0; lines < CHUNK_LINES && cursor < batch->inputSize; ++lines) {
+        const char* newline = memchr(input + cursor, '\n', batch->inputSize - cursor);
+
+        cursor = newline ? (size_t)(newline - input) + 1 : batch->inputSize;
+        batch->nextLine++;
+    }
+    *end = batch->cursor = cursor;
+    *chunk = batch->nextChunk++;
+    pthread_mutex_unlock(&batch->lock);
+    return true;
+}
+
+/**
+ * submitChunk - parks @text as @chunk's result (taking its buffer and
+ * handing back the slot's empty one) and writes every chunk that is
+ * now next in line
+ */
+static void submitChunk(Batch* batch, uint64_t chunk, Buffer* text, uint64_t positions, uint64_t errors,
+                        uint64_t nodes) {
+    Slot* slot = &batch->window[chunk % batch->windowSize];
+    Buffer swap;
+
+    pthread_mutex_lock(&batch->lock);
+    swap = slot->text;
+    slot->text = *text;
+    slot->ready = true;
+    *text = swap;
+    text->length = 0;
+
+    batch->positions += positions;
+    batch->errors += errors;
+    batch->nodes += nodes;
+
+    slot = &batch->window[batch->nextWrite % batch->windowSize];
+    if (slot->ready) {
+        while (slot->ready) {
+            fwrite(slot->text.data, 1, slot->text.length, batch->output);
+            slot->text.length = 0;
+            slot->ready = false;
+            batch->nextWrite++;
+            slot = &batch->window[batch->nextWrite % batch->windowSize];
+        }
+        pthread_cond_broadcast(&batch->advanced);
+    }
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * workerMain - analyses chunks until the input runs out. Every worker
+ * owns a single-threaded search and its own table, so workers share
+ * nothing but the chunk counter and the output window.
+ */
+static void* workerMain(void* arg) {
+    Worker* worker = arg;
+    Batch* batch = worker->batch;
+    Search search;
+    TransTable tt = {0};
+    Buffer text = {0};
+    uint64_t chunk, firstLine;
+    size_t begin, end;
+
+    if (!searchInit(&search, 1) || !ttResize(&tt, batch->hashMb)) {
+        fprintf(stderr, "chess-batch: could not allocate a %zu MB worker\n", batch->hashMb);
+        exit(EXIT_FAILURE);
+    }
+    search.tt = &tt;
+
+    while (claimChunk(batch, &chunk, &begin, &end, &firstLine)) {
+        uint64_t positions = 0, errors = 0, nodes = 0;
+        uint64_t line = firstLine;
+
+        for (size_t at = begin; at < end; ++line) {
+            const char* start = batch->input + at;
+            const char* newline = memchr(start, '\n', end - at);
+            size_t length = newline ? (size_t)(newline - start) : end - at;
+            char buffer[LINE_MAX_LENGTH], id[LINE_MAX_LENGTH], fen[FEN_MAX];
+            const char* error;
+            SearchInfo info;
+            Position pos;
+            Move best = MOVE_NONE;
+
+            at += length + 1;
+            while (length && isspace((unsigned char)start[length - 1])) length--;
+            while (length && isspace((unsigned char)*start)) start++, length--;
+            if (!length || *start == '#') continue;
+
+            if (length >= sizeof(buffer)) {
+                snprintf(buffer, sizeof(buffer), "%.*s", (int)sizeof(fen) - 1, start);
+                error = "line too long";
+                id[0] = '\0';
+            } else {
+                memcpy(buffer, start, length);
+                buffer[length] = '\0';
+                error = parseLine(&pos, buffer, id, sizeof(id));
+            }
+
+            if (error) {
+                errors++;
+                buffer[strcspn(buffer, ";")] = '\0';
+                formatResult(&text, batch->format, line, buffer, id, NULL, MOVE_NONE, error);
+                continue;
+            }
+            best = searchRun(&search, &pos, &batch->limits, &info);
+            positions++;
+            nodes += info.nodes;
+            formatResult(&text, batch->format, line, positionToFen(&pos, fen), id, &info, best, NULL);
+        }
+        submitChunk(batch, chunk, &text, positions, errors, nodes);
+    }
+
+    free(text.data);
+    ttFree(&tt);
+    searchFree(&search);
+    return NULL;
+}
+
+static bool parseCount(const char* text, long long min, long long* value) {
+    char* end;
+
+    *value = strtoll(text, &end, 10);
+    return *text && !*end && *value >= min;
+}
+
+int main(int argc, char** argv) {
+    Batch batch = {0};
+    const char *inputPath = NULL, *outputPath = NULL;
+    char bitbasePath[BITBASE_PATH_MAX];
+    bool printStats = false;
+    long long threads = sysconf(_SC_NPROCESSORS_ONLN), value;
+    Worker* workers;
+    struct stat info;
+    int64_t start;
+    int fd;
+
+    batch.format = FORMAT_CSV;
+    batch.hashMb = BATCH_DEFAULT_HASH_MB;
+    batch.limits.depth = BATCH_DEFAULT_DEPTH;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : "";
+
+        if (strcmp(arg, "--depth") == 0 && parseCount(next, 1, &value) && value < MAX_PLY) {
+            batch.limits.depth = (int)value;
+            batch.limits.nodes = 0;
+            i++;
+        } else if (strcmp(arg, "--nodes") == 0 && parseCount(next, 1, &value)) {
+            batch.limits.nodes = (uint64_t)value;
+            batch.limits.depth = 0;
+            i++;
+        } else if (strcmp(arg, "--threads") == 0 && parseCount(next, 1, &value)) {
+            threads = value;
+            i++;
+        } else if (strcmp(arg, "--hash") == 0 && parseCount(next, 1, &value)) {
+            batch.hashMb = (size_t)value;
+            i++;
+        } else if (strcmp(arg, "--format") == 0 && (strcmp(next, "csv") == 0 || strcmp(next, "json") == 0)) {
+            batch.format = (strcmp(next, "csv") == 0) ? FORMAT_CSV : FORMAT_JSON;
+            i++;
+        } else if (strcmp(arg, "--stats") == 0) {
+            printStats = true;
+        } else if (strcmp(arg, "--output") == 0 && *next) {
+            outputPath = next;
+            i++;
+        } else if (*arg != '-' && !inputPath) {
+            inputPath = arg;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!inputPath) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (threads < 1) threads = 1;
+
+    /* Map the input rather than read it: pages are faulted in as the
+     * workers reach them and dropped by the kernel when memory is short */
+    if ((fd = open(inputPath, O_RDONLY)) < 0 || fstat(fd, &info) < 0) {
+        perror(inputPath);
+        return EXIT_FAILURE;
+    }
+    batch.inputSize = (size_t)info.st_size;
+    if (batch.inputSize) {
+        void* mapped = mmap(NULL, batch.inputSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped == MAP_FAILED) {
+            perror(inputPath);
+            return EXIT_FAILURE;
+        }
+        madvise(mapped, batch.inputSize, MADV_SEQUENTIAL);
+        batch.input = mapped;
+    }
+    close(fd);
+
+    batch.output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!batch.output) {
+        perror(outputPath);
+        return EXIT_FAILURE;
+    }
+    setvbuf(batch.output, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    chessCoreInit();
+    if (!bitbaseDefaultPath(bitbasePath, sizeof(bitbasePath)) || !bitbaseInit(bitbasePath, (int)threads)) {
+        fprintf(stderr, "chess-batch: bitbases unavailable\n");
+    }
+    batch.nextLine = 1;
+    batch.windowSize = (size_t)threads * WINDOW_PER_THREAD;
+    batch.window = calloc(batch.windowSize, sizeof(Slot));
+    workers = calloc((size_t)threads, sizeof(Worker));
+    if (!batch.window || !workers) {
+        fprintf(stderr, "chess-batch: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.advanced, NULL);
+    writeHeader(&batch);
+
+    statsReset();
+    start = timeNowMs();
+    for (long long i = 0; i < threads; ++i) {
+        pthread_attr_t attr;
+
+        workers[i].batch = &batch;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, SEARCH_STACK_SIZE);
+        workers[i].started = pthread_create(&workers[i].handle, &attr, workerMain, &workers[i]) == 0;
+        pthread_attr_destroy(&attr);
+        if (!workers[i].started) {
+            fprintf(stderr, "chess-batch: started only %lld of %lld workers\n", i, threads);
+            if (i == 0) return EXIT_FAILURE;
+            break;
+        }
+    }
+    for (long long i = 0; i < threads; ++i) {
+        if (workers[i].started) pthread_join(workers[i].handle, NULL);
+    }
+
+    fflush(batch.output);
+    if (outputPath) fclose(batch.output);
+    {
+        int64_t elapsed = timeNowMs() - start;
+
+        fprintf(stderr, "chess-batch: %llu positions, %llu errors, %llu nodes in %lld ms (%.1f positions/s)\n",
+                (unsigned long long)batch.positions, (unsigned long long)batch.errors,
+                (unsigned long long)batch.nodes, (long long)elapsed,
+                (double)batch.positions * 1000.0 / (double)(elapsed > 0 ? elapsed : 1));
+    }
+    if (printStats && STATS_ENABLED) {
+        Stats stats;
+        char json[1024];
+
+        statsCollect(&stats);
+        statsFormatJson(&stats, json, sizeof(json));
+        fprintf(stderr, "chess-batch: stats %s\n", json);
+    } else if (printStats) {
+        fprintf(stderr, "chess-batch: stats not compiled in, configure with -DCHESS_STATS=ON\n");
+    }
+
+    for (size_t i = 0; i < batch.windowSize; ++i) free(batch.window[i].text.data);
+    free(batch.window);
+    free(workers);
+    if (batch.input) munmap((void*)batch.input, batch.inputSize);
+    bitbaseFree();
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.advanced);
+    return batch.errors ? 2 : EXIT_SUCCESS;
+}
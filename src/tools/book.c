@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "book.h"
+#include "movegen.h"
+
+#define BOOK_DEFAULT_PLIES 16
+#define GAME_LINE_MAX 8192
+
+/**
+ * BookEntry - one (position, move) pair seen in the input and how often
+ */
+typedef struct {
+    uint64_t key;
+    uint16_t move;
+    uint32_t count;
+} BookEntry;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--plies N] [--min N] games.txt book.bin\n"
+            "Each input line is one game as coordinate moves from the start\n"
+            "position (\"e2e4 e7e5 g1f3 ...\"); a leading \"startpos moves\" is\n"
+            "allowed. The first N plies (default %d) of every game are entered,\n"
+            "weighted by how often each move was played; moves seen fewer than\n"
+            "--min times are dropped.\n",
+            program, BOOK_DEFAULT_PLIES);
+}
+
+static int compareEntries(const void* a, const void* b) {
+    const BookEntry* x = a;
+    const BookEntry* y = b;
+
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    if (x->move != y->move) return (x->move < y->move) ? -1 : 1;
+    return 0;
+}
+
+/* Within a key, the most played move first, as Polyglot tools expect */
+static int compareWeights(const void* a, const void* b) {
+    const BookEntry* x = a;
+    const BookEntry* y = b;
+
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    return (x->count > y->count) ? -1 : (x->count < y->count);
+}
+
+static void writeBig(FILE* file, uint64_t value, int length) {
+    for (int i = length - 1; i >= 0; --i) {
+        fputc((int)((value >> (8 * i)) & 0xFF), file);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char *inputPath = NULL, *outputPath = NULL;
+    int plies = BOOK_DEFAULT_PLIES, minCount = 1;
+    BookEntry* entries = NULL;
+    size_t count = 0, capacity = 0, merged = 0;
+    char line[GAME_LINE_MAX];
+    FILE *input, *output;
+    int games = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            plies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            minCount = atoi(argv[++i]);
+        } else if (!inputPath) {
+            inputPath = argv[i];
+        } else if (!outputPath) {
+            outputPath = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!inputPath || !outputPath || plies < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!(input = fopen(inputPath, "r"))) {
+        perror(inputPath);
+        return EXIT_FAILURE;
+    }
+
+    chessCoreInit();
+    while (fgets(line, sizeof(line), input)) {
+        Position pos;
+        UndoInfo undo;
+        int ply = 0;
+
+        positionSetStart(&pos);
+        for (char* token = strtok(line, " \t\r\n"); token && ply < plies; token = strtok(NULL, " \t\r\n")) {
+            Move move;
+
+            if (strcmp(token, "startpos") == 0 || strcmp(token, "moves") == 0) continue;
+            if ((move = moveFromString(&pos, token)) == MOVE_NONE) {
+                fprintf(stderr, "%s: game %d: illegal move %s, rest of game skipped\n", inputPath, games + 1, token);
+                break;
+            }
+            if (count == capacity) {
+                BookEntry* grown;
+
+                capacity = capacity ? capacity * 2 : 4096;
+                if (!(grown = realloc(entries, capacity * sizeof(BookEntry)))) {
+                    fprintf(stderr, "chess-book: out of memory\n");
+                    return EXIT_FAILURE;
+                }
+                entries = grown;
+            }
+            entries[count].key = bookKey(&pos);
+            entries[count].move = bookEncodeMove(move);
+            entries[count++].count = 1;
+
+            positionMakeMove(&pos, move, &undo);
+            pos.history = NULL;
+            ply++;
+        }
+        games++;
+    }
+    fclose(input);
+
+    /* Fold repeated (position, move) pairs into one weighted entry */
+    qsort(entries, count, sizeof(BookEntry), compareEntries);
+    for (size_t i = 0; i < count; ++i) {
+        if (merged && entries[merged - 1].key == entries[i].key && entries[merged - 1].move == entries[i].move) {
+            entries[merged - 1].count++;
+        } else {
+            entries[merged++] = entries[i];
+        }
+    }
+    qsort(entries, merged, sizeof(BookEntry), compareWeights);
+
+    if (!(output = fopen(outputPath, "wb"))) {
+        perror(outputPath);
+        return EXIT_FAILURE;
+    }
+    count = 0;
+    for (size_t i = 0; i < merged; ++i) {
+        if (entries[i].count < (uint32_t)minCount) continue;
+        writeBig(output, entries[i].key, 8);
+        writeBig(output, entries[i].move, 2);
+        writeBig(output, entries[i].count > 0xFFFF ? 0xFFFF : entries[i].count, 2);
+        writeBig(output, 0, 4);
+        count++;
+    }
+    fclose(output);
+    free(entries);
+
+    fprintf(stderr, "chess-book: %d games, %zu entries written to %s\n", games, count, outputPath);
+    return EXIT_SUCCESS;
+}
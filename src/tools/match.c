@@ -0,0 +1,1062 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "bitbase.h"
+#include "misc.h"
+#include "movegen.h"
+#include "pgn.h"
+#include "record.h"
+#include "search.h"
+
+#define MATCH_DEFAULT_GAMES 100
+#define MATCH_DEFAULT_HASH_MB 16
+#define MATCH_DEFAULT_MAX_MOVES 300
+#define ENGINE_NAME_MAX 64
+#define ENGINE_COMMAND_MAX 256
+#define ENGINE_OPTIONS_MAX 16
+#define ENGINE_OPTION_MAX 64
+#define UCI_LINE_MAX 4096
+#define UCI_HANDSHAKE_MS 10000  /** time an engine gets to answer uci/isready */
+#define UCI_GRACE_MS 1000       /** past its clock before an engine is given up on */
+#define SEARCH_STACK_SIZE (8 * 1024 * 1024)
+
+#define DARK_SQUARES_BB 0xAA55AA55AA55AA55ULL
+
+/**
+ * EngineSpec - one side of the match. The built-in search is played
+ * in-process with its own table; with a command the engine is started
+ * as a UCI child process, which is how two different builds are
+ * compared. depth or nodes replace the match's time control for this
+ * engine alone.
+ */
+typedef struct {
+    char name[ENGINE_NAME_MAX];
+    char command[ENGINE_COMMAND_MAX];   /** empty for the built-in search */
+    size_t hashMb;
+    size_t pawnHashKb;                  /** built in, 0 for the default */
+    int threads;
+    int depth;
+    uint64_t nodes;
+    char options[ENGINE_OPTIONS_MAX][2][ENGINE_OPTION_MAX];    /** UCI setoption name, value */
+    int optionCount;
+} EngineSpec;
+
+/**
+ * Player - a running engine, owned by one worker for the whole match
+ */
+typedef struct {
+    const EngineSpec* spec;
+
+    Search search;
+    TransTable tt;
+
+    pid_t pid;
+    FILE* toEngine;
+    int fromEngine;
+    char buffer[UCI_LINE_MAX];
+    size_t buffered;
+} Player;
+
+/**
+ * Opening - a start position and the moves that lead out of it
+ */
+typedef struct {
+    Position start;
+    Move* moves;
+    int moveCount;
+} Opening;
+
+/**
+ * Adjudication - when a game is decided before the rules end it; zero
+ * counts switch a rule off
+ */
+typedef struct {
+    int drawMoveNumber;     /** no draw adjudication before this move */
+    int drawMoveCount;      /** consecutive moves of each side within drawScore */
+    int drawScore;
+    int resignMoveCount;    /** consecutive own moves at or below -resignScore */
+    int resignScore;
+    int maxMoves;           /** drawn after this many moves */
+    bool bitbases;          /** decide covered endings from the bitbases */
+} Adjudication;
+
+typedef struct {
+    double elo0, elo1;
+    double alpha, beta;
+    bool enabled;
+} Sprt;
+
+/**
+ * GameOutcome - how a game ended; winner is NONE for a draw
+ */
+typedef struct {
+    PieceColor winner;
+    const char* termination;    /** PGN Termination tag */
+    char reason[96];
+} GameOutcome;
+
+/**
+ * Match - the shared state. Workers claim game numbers in order; games
+ * 2k and 2k+1 play opening k with the colors swapped. Results are
+ * counted from engines[0]'s side.
+ */
+typedef struct {
+    EngineSpec engines[2];
+    Opening* openings;
+    int openingCount;
+    SearchLimits limits;        /** time control, time[WHITE] the base for both */
+    char timeControl[32];       /** PGN TimeControl tag */
+    Adjudication adjudication;
+    Sprt sprt;
+
+    int games;
+    int nextGame;
+    int finished;
+    int wins, draws, losses;
+    bool stop;                  /** the SPRT has decided, start no more games */
+
+    FILE* pgn;
+    char date[16];
+    pthread_mutex_t lock;
+} Match;
+
+typedef struct {
+    Match* match;
+    Player players[2];
+    GameRecord record;
+    PgnGame pgn;
+    pthread_t handle;
+    bool started;
+} Worker;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s --engine SPEC --engine SPEC [options]\n"
+            "Plays the two engines against each other, one game per worker,\n"
+            "and reports the score, Elo difference and SPRT state as games end.\n"
+            "  --engine SPEC        comma-separated key=value list:\n"
+            "                         name=N         name in reports and PGN\n"
+            "                         cmd=PATH       run a UCI engine (e.g. another build\n"
+            "                                        of chess-uci); built-in search without\n"
+            "                         hash=MB        table size (default %d)\n"
+            "                         threads=N      search threads (default 1)\n"
+            "                         pawnhash=KB    pawn cache per thread, built in only\n"
+            "                         depth=N        fixed depth instead of the clock\n"
+            "                         nodes=N        fixed nodes instead of the clock\n"
+            "                         option.X=V     setoption name X value V, UCI only\n"
+            "  --tc BASE[+INC]      clock in seconds, e.g. 10+0.1\n"
+            "  --movetime MS        fixed time per move instead\n"
+            "  --depth N            fixed depth per move instead\n"
+            "  --nodes N            fixed nodes per move instead\n"
+            "  --games N            games to play, in pairs with colors swapped (default %d)\n"
+            "  --concurrency N      games played at once (default: one per core, divided\n"
+            "                       by the engines' thread count)\n"
+            "  --openings FILE      EPD/FEN lines, or PGN games when FILE ends in .pgn;\n"
+            "                       played in order, each once per color\n"
+            "  --plies N            use at most N moves of each PGN opening\n"
+            "  --pgn FILE           write every game to FILE\n"
+            "  --sprt E0,E1[,A,B]   stop once H0 (Elo E0) or H1 (Elo E1) is accepted,\n"
+            "                       alpha A and beta B (default 0.05)\n"
+            "  --draw N,M,S         adjudicate a draw from move N when both sides\n"
+            "                       score within S cp for M moves each\n"
+            "  --resign M,S         a side resigns after M moves at or below -S cp\n"
+            "  --maxmoves N         adjudicate a draw after N moves (default %d)\n"
+            "  --bitbases           decide covered endings from the bitbases\n"
+            "Without --openings every game starts from the initial position.\n"
+            "Endgame bitbases live in $%s, or ~/.cache/%s.\n",
+            program, MATCH_DEFAULT_HASH_MB, MATCH_DEFAULT_GAMES, MATCH_DEFAULT_MAX_MOVES, BITBASE_PATH_ENV,
+            BITBASE_CACHE_DIR);
+}
+
+static bool parseCount(const char* text, long long min, long long* value) {
+    char* end;
+
+    *value = strtoll(text, &end, 10);
+    return *text && !*end && *value >= min;
+}
+
+/**
+ * parseNumbers - reads up to @count comma-separated numbers from @text
+ *
+ * Return: how many were read, -1 if @text is malformed
+ */
+static int parseNumbers(const char* text, double* values, int count) {
+    int read = 0;
+
+    while (*text && read < count) {
+        char* end;
+
+        values[read++] = strtod(text, &end);
+        if (end == text || (*end && *end != ',')) return -1;
+        text = *end ? end + 1 : end;
+    }
+    return *text ? -1 : read;
+}
+
+/**
+ * parseClock - reads a time control of BASE or BASE+INC seconds
+ */
+static bool parseClock(const char* text, double* base, double* increment) {
+    char* end;
+
+    *base = strtod(text, &end);
+    *increment = 0;
+    if (end == text || *base <= 0) return false;
+    if (*end == '+') {
+        text = end + 1;
+        *increment = strtod(text, &end);
+        if (end == text || *increment < 0) return false;
+    }
+    return !*end;
+}
+
+/**
+ * parseEngine - fills @spec from a comma-separated key=value list
+ *
+ * Return: false on an unknown key or a bad value
+ */
+static bool parseEngine(EngineSpec* spec, const char* text) {
+    char copy[1024], *field, *save;
+    long long value;
+
+    snprintf(copy, sizeof(copy), "%s", text);
+    for (field = strtok_r(copy, ",", &save); field; field = strtok_r(NULL, ",", &save)) {
+        char* equals = strchr(field, '=');
+        const char* val;
+
+        if (!equals) return false;
+        *equals = '\0';
+        val = equals + 1;
+
+        if (strcmp(field, "name") == 0) {
+            snprintf(spec->name, sizeof(spec->name), "%s", val);
+        } else if (strcmp(field, "cmd") == 0) {
+            snprintf(spec->command, sizeof(spec->command), "%s", val);
+        } else if (strcmp(field, "hash") == 0 && parseCount(val, 1, &value)) {
+            spec->hashMb = (size_t)value;
+        } else if (strcmp(field, "pawnhash") == 0 && parseCount(val, 1, &value)) {
+            spec->pawnHashKb = (size_t)value;
+        } else if (strcmp(field, "threads") == 0 && parseCount(val, 1, &value) && value <= MAX_THREADS) {
+            spec->threads = (int)value;
+        } else if (strcmp(field, "depth") == 0 && parseCount(val, 1, &value) && value < MAX_PLY) {
+            spec->depth = (int)value;
+        } else if (strcmp(field, "nodes") == 0 && parseCount(val, 1, &value)) {
+            spec->nodes = (uint64_t)value;
+        } else if (strncmp(field, "option.", 7) == 0 && field[7] && spec->optionCount < ENGINE_OPTIONS_MAX) {
+            snprintf(spec->options[spec->optionCount][0], ENGINE_OPTION_MAX, "%s", field + 7);
+            snprintf(spec->options[spec->optionCount][1], ENGINE_OPTION_MAX, "%s", val);
+            spec->optionCount++;
+        } else {
+            return false;
+        }
+    }
+    if (!spec->command[0] && spec->optionCount) return false;
+    return true;
+}
+
+/**
+ * readLine - the next line the engine writes, waiting until @deadline
+ * (timeNowMs, 0 for no limit)
+ *
+ * Return: false on timeout or when the engine has gone away
+ */
+static bool readLine(Player* player, char* line, size_t size, int64_t deadline) {
+    for (;;) {
+        char* newline = memchr(player->buffer, '\n', player->buffered);
+        struct pollfd poller = {player->fromEngine, POLLIN, 0};
+        int wait = -1, ready;
+        ssize_t got;
+
+        if (newline) {
+            size_t length = (size_t)(newline - player->buffer);
+            size_t copy = (length < size - 1) ? length : size - 1;
+
+            memcpy(line, player->buffer, copy);
+            line[copy] = '\0';
+            if (copy && line[copy - 1] == '\r') line[copy - 1] = '\0';
+            player->buffered -= length + 1;
+            memmove(player->buffer, newline + 1, player->buffered);
+            return true;
+        }
+        /* A line longer than the buffer is of no interest, drop it */
+        if (player->buffered == sizeof(player->buffer)) player->buffered = 0;
+
+        if (deadline) {
+            int64_t left = deadline - timeNowMs();
+
+            if (left <= 0) return false;
+            wait = (int)left;
+        }
+        ready = poll(&poller, 1, wait);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false;
+        got = read(player->fromEngine, player->buffer + player->buffered,
+                   sizeof(player->buffer) - player->buffered);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        player->buffered += (size_t)got;
+    }
+}
+
+/**
+ * waitFor - reads lines until one is exactly @expected
+ */
+static bool waitFor(Player* player, const char* expected, int64_t deadline) {
+    char line[UCI_LINE_MAX];
+
+    while (readLine(player, line, sizeof(line), deadline)) {
+        if (strcmp(line, expected) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * spawnEngine - starts @command through the shell with pipes on its
+ * standard input and output
+ */
+static bool spawnEngine(Player* player, const char* command) {
+    int toChild[2], fromChild[2];
+
+    if (pipe2(toChild, O_CLOEXEC) < 0) return false;
+    if (pipe2(fromChild, O_CLOEXEC) < 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+    if ((player->pid = fork()) < 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+        return false;
+    }
+    if (player->pid == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+    close(toChild[0]);
+    close(fromChild[1]);
+    player->fromEngine = fromChild[0];
+    player->toEngine = fdopen(toChild[1], "w");
+    return player->toEngine != NULL;
+}
+
+static void sendLine(Player* player, const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(player->toEngine, format, args);
+    va_end(args);
+    fputc('\n', player->toEngine);
+    fflush(player->toEngine);
+}
+
+/**
+ * playerStart - brings up the engine described by @spec
+ */
+static bool playerStart(Player* player, const EngineSpec* spec) {
+    int64_t deadline;
+
+    memset(player, 0, sizeof(*player));
+    player->spec = spec;
+    player->fromEngine = -1;
+
+    if (!spec->command[0]) {
+        if (!searchInit(&player->search, spec->threads) || !ttResize(&player->tt, spec->hashMb)) return false;
+        if (spec->pawnHashKb && !searchSetPawnHash(&player->search, spec->pawnHashKb)) return false;
+        player->search.tt = &player->tt;
+        return true;
+    }
+
+    if (!spawnEngine(player, spec->command)) return false;
+    deadline = timeNowMs() + UCI_HANDSHAKE_MS;
+    sendLine(player, "uci");
+    if (!waitFor(player, "uciok", deadline)) return false;
+    sendLine(player, "setoption name Hash value %zu", spec->hashMb);
+    sendLine(player, "setoption name Threads value %d", spec->threads);
+    for (int i = 0; i < spec->optionCount; ++i) {
+        sendLine(player, "setoption name %s value %s", spec->options[i][0], spec->options[i][1]);
+    }
+    sendLine(player, "isready");
+    return waitFor(player, "readyok", timeNowMs() + UCI_HANDSHAKE_MS);
+}
+
+static void playerQuit(Player* player) {
+    if (!player->spec) return;
+    if (!player->spec->command[0]) {
+        ttFree(&player->tt);
+        searchFree(&player->search);
+        return;
+    }
+    if (player->toEngine) {
+        sendLine(player, "quit");
+        fclose(player->toEngine);
+    }
+    if (player->fromEngine >= 0) close(player->fromEngine);
+    if (player->pid > 0) waitpid(player->pid, NULL, 0);
+}
+
+/**
+ * playerNewGame - forgets the last game. An engine that fell silent
+ * during it gets a stop first, so its late bestmove is read and dropped
+ * here rather than taken for the next game's first move.
+ *
+ * Return: false if the engine no longer answers
+ */
+static bool playerNewGame(Player* player) {
+    if (!player->spec->command[0]) {
+        ttClear(&player->tt);
+        return true;
+    }
+    sendLine(player, "stop");
+    sendLine(player, "ucinewgame");
+    sendLine(player, "isready");
+    return waitFor(player, "readyok", timeNowMs() + UCI_HANDSHAKE_MS);
+}
+
+/**
+ * parseScore - the score of a UCI info line, if it has one
+ */
+static bool parseScore(const char* line, int* score) {
+    const char* at = strstr(line, " score ");
+    int value;
+
+    if (!at) return false;
+    at += 7;
+    if (sscanf(at, "cp %d", &value) == 1) {
+        *score = value;
+    } else if (sscanf(at, "mate %d", &value) == 1) {
+        *score = (value > 0) ? VALUE_MATE - 2 * value + 1 : -VALUE_MATE - 2 * value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * uciThink - sends the game so far and the limits to an external
+ * engine and waits for its move
+ */
+static Move uciThink(Player* player, const GameRecord* record, const Position* pos, const SearchLimits* limits,
+                     int* score) {
+    char fen[FEN_MAX], move[6], line[UCI_LINE_MAX];
+    int64_t deadline = 0;
+
+    fprintf(player->toEngine, "position fen %s", positionToFen(&record->start, fen));
+    if (record->ply) fputs(" moves", player->toEngine);
+    for (int i = 0; i < record->ply; ++i) {
+        fprintf(player->toEngine, " %s", moveToString(recordMove(record, i), move));
+    }
+    fputc('\n', player->toEngine);
+
+    if (limits->depth) {
+        sendLine(player, "go depth %d", limits->depth);
+    } else if (limits->nodes) {
+        sendLine(player, "go nodes %llu", (unsigned long long)limits->nodes);
+    } else if (limits->moveTime) {
+        sendLine(player, "go movetime %lld", (long long)limits->moveTime);
+        deadline = timeNowMs() + limits->moveTime + UCI_GRACE_MS;
+    } else {
+        sendLine(player, "go wtime %lld btime %lld winc %lld binc %lld",
+                 (long long)limits->time[WHITE], (long long)limits->time[BLACK],
+                 (long long)limits->increment[WHITE], (long long)limits->increment[BLACK]);
+        deadline = timeNowMs() + limits->time[pos->sideToMove] + UCI_GRACE_MS;
+    }
+
+    while (readLine(player, line, sizeof(line), deadline)) {
+        if (strncmp(line, "info ", 5) == 0) {
+            parseScore(line, score);
+        } else if (strncmp(line, "bestmove ", 9) == 0) {
+            char text[8] = "";
+
+            sscanf(line + 9, "%7s", text);
+            return moveFromString(pos, text);
+        }
+    }
+    return MOVE_NONE;
+}
+
+/**
+ * playerThink - the engine's move in @pos, MOVE_NONE if it sent an
+ * illegal one or none in time; @score is from the mover's side
+ */
+static Move playerThink(Player* player, const GameRecord* record, const Position* pos, const SearchLimits* limits,
+                        int* score) {
+    SearchInfo info;
+    Move move;
+
+    *score = 0;
+    if (player->spec->command[0]) return uciThink(player, record, pos, limits, score);
+
+    move = searchRun(&player->search, pos, limits, &info);
+    *score = info.score;
+    return move;
+}
+
+/**
+ * insufficientMaterial - neither side can ever mate: bare kings, a
+ * single minor piece, or bishops that all stand on one color
+ */
+static bool insufficientMaterial(const Position* pos) {
+    Bitboard bishops = pos->byType[BISHOP];
+
+    if (pos->byType[PAWN] | pos->byType[ROOK] | pos->byType[QUEEN]) return false;
+    if (popCount(pos->byType[KNIGHT] | bishops) <= 1) return true;
+    return !pos->byType[KNIGHT] && (!(bishops & DARK_SQUARES_BB) || !(bishops & ~DARK_SQUARES_BB));
+}
+
+static void setOutcome(GameOutcome* outcome, PieceColor winner, const char* termination, const char* format, ...) {
+    va_list args;
+
+    outcome->winner = winner;
+    outcome->termination = termination;
+    va_start(args, format);
+    vsnprintf(outcome->reason, sizeof(outcome->reason), format, args);
+    va_end(args);
+}
+
+static const char* colorName(PieceColor color) {
+    return (color == WHITE) ? "White" : "Black";
+}
+
+/**
+ * gameOver - whether the game ends in @pos, by the rules first, then by
+ * bitbase and move-limit adjudication
+ */
+static bool gameOver(const Match* match, const Position* pos, GameOutcome* outcome) {
+    PieceColor us = pos->sideToMove;
+
+    if (positionIsCheckMate(pos)) {
+        setOutcome(outcome, OPPONENT(us), "normal", "%s mates", colorName(OPPONENT(us)));
+    } else if (positionIsStaleMate(pos)) {
+        setOutcome(outcome, NONE, "normal", "stalemate");
+    } else if (pos->rule50 >= 100) {
+        setOutcome(outcome, NONE, "normal", "fifty-move rule");
+    } else if (positionIsDraw(pos, 0)) {
+        setOutcome(outcome, NONE, "normal", "threefold repetition");
+    } else if (insufficientMaterial(pos)) {
+        setOutcome(outcome, NONE, "normal", "insufficient material");
+    } else if (match->adjudication.maxMoves && pos->fullmoveNumber > match->adjudication.maxMoves) {
+        setOutcome(outcome, NONE, "adjudication", "move limit");
+    } else if (match->adjudication.bitbases) {
+        switch (bitbaseProbe(pos)) {
+        case BITBASE_WIN:
+            setOutcome(outcome, us, "adjudication", "bitbase win for %s", colorName(us));
+            break;
+        case BITBASE_LOSS:
+            setOutcome(outcome, OPPONENT(us), "adjudication", "bitbase win for %s", colorName(OPPONENT(us)));
+            break;
+        case BITBASE_DRAW:
+            setOutcome(outcome, NONE, "adjudication", "bitbase draw");
+            break;
+        default:
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * playGame - plays game number @game on @worker's engines
+ */
+static GameOutcome playGame(Worker* worker, int game) {
+    Match* match = worker->match;
+    const Adjudication* adjudication = &match->adjudication;
+    const Opening* opening = &match->openings[(game / 2) % match->openingCount];
+    Player* players[3] = {NULL, &worker->players[game & 1], &worker->players[!(game & 1)]};
+    GameRecord* record = &worker->record;
+    PgnGame* pgn = &worker->pgn;
+    Position pos = opening->start;
+    int64_t clock[3] = {0, match->limits.time[WHITE], match->limits.time[WHITE]};
+    int drawPlies = 0, losingMoves[3] = {0};
+    GameOutcome outcome;
+
+    pos.history = NULL;
+    recordReset(record, &pos);
+    pgnGameReset(pgn, &pos);
+    for (int i = 0; i < opening->moveCount; ++i) {
+        recordPlay(record, &pos, opening->moves[i]);
+        pgnGameAddMove(pgn, opening->moves[i]);
+    }
+    for (PieceColor color = WHITE; color <= BLACK; ++color) {
+        if (!playerNewGame(players[color])) {
+            setOutcome(&outcome, OPPONENT(color), "rules infraction", "%s stopped responding",
+                       players[color]->spec->name);
+            return outcome;
+        }
+    }
+
+    while (!gameOver(match, &pos, &outcome)) {
+        PieceColor us = pos.sideToMove;
+        Player* player = players[us];
+        const EngineSpec* spec = player->spec;
+        SearchLimits limits = {0};
+        bool clocked = false;
+        int64_t start, elapsed;
+        int score;
+        Move move;
+
+        if (spec->depth || spec->nodes) {
+            limits.depth = spec->depth;
+            limits.nodes = spec->nodes;
+        } else {
+            limits = match->limits;
+            limits.time[WHITE] = clock[WHITE];
+            limits.time[BLACK] = clock[BLACK];
+            clocked = limits.time[us] > 0;
+        }
+
+        start = timeNowMs();
+        move = playerThink(player, record, &pos, &limits, &score);
+        elapsed = timeNowMs() - start;
+
+        if (clocked && (clock[us] -= elapsed) < 0) {
+            setOutcome(&outcome, OPPONENT(us), "time forfeit", "%s loses on time", colorName(us));
+            break;
+        }
+        if (move == MOVE_NONE) {
+            setOutcome(&outcome, OPPONENT(us), "rules infraction", "%s makes no legal move", colorName(us));
+            break;
+        }
+        if (clocked) clock[us] += limits.increment[us];
+
+        recordPlay(record, &pos, move);
+        pgnGameAddMove(pgn, move);
+
+        /* Score adjudication waits for the rules: a mating move is never
+         * scored within the draw window, and a mated side has no move
+         * left to resign with */
+        losingMoves[us] = (adjudication->resignMoveCount && score <= -adjudication->resignScore)
+                        ? losingMoves[us] + 1 : 0;
+        drawPlies = (adjudication->drawMoveCount && abs(score) <= adjudication->drawScore) ? drawPlies + 1 : 0;
+
+        if (gameOver(match, &pos, &outcome)) break;
+        if (adjudication->resignMoveCount && losingMoves[us] >= adjudication->resignMoveCount) {
+            setOutcome(&outcome, OPPONENT(us), "adjudication", "%s resigns", colorName(us));
+            break;
+        }
+        if (adjudication->drawMoveCount && drawPlies >= 2 * adjudication->drawMoveCount
+            && pos.fullmoveNumber >= adjudication->drawMoveNumber) {
+            setOutcome(&outcome, NONE, "adjudication", "draw by score");
+            break;
+        }
+    }
+    return outcome;
+}
+
+static double eloFromScore(double score) {
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+/**
+ * printScore - the running result, from engines[0]'s side: score,
+ * Elo difference with its 95% interval, likelihood of superiority and
+ * the SPRT log-likelihood ratio
+ *
+ * The SPRT uses the normal approximation of the trinomial GSPRT: with
+ * mean score s and per-game variance v over n games, the LLR of H1
+ * (expected score s1) against H0 (s0) is n (s1 - s0)(2s - s0 - s1) / 2v.
+ *
+ * Return: 1 once H1 is accepted, -1 for H0, 0 while undecided
+ */
+static int printScore(const Match* match) {
+    const EngineSpec* engines = match->engines;
+    double games = match->wins + match->draws + match->losses;
+    double score = (match->wins + 0.5 * match->draws) / games;
+    double variance = (match->wins * (1.0 - score) * (1.0 - score) + match->draws * (0.5 - score) * (0.5 - score)
+                       + match->losses * score * score) / games;
+    double margin = 1.959964 * sqrt(variance / games);
+    double low = fmax(score - margin, 0.0), high = fmin(score + margin, 1.0);
+    double decisive = match->wins + match->losses;
+    double los = decisive ? 0.5 * (1.0 + erf((match->wins - match->losses) / sqrt(2.0 * decisive))) : 0.5;
+    int decision = 0;
+
+    printf("Score of %s vs %s: %d - %d - %d [%.3f] %d\n", engines[0].name, engines[1].name,
+           match->wins, match->losses, match->draws, score, match->finished);
+    printf("Elo difference: %+.1f +/- %.1f, LOS: %.1f %%, DrawRatio: %.1f %%\n", eloFromScore(score),
+           (eloFromScore(high) - eloFromScore(low)) / 2.0, los * 100.0,
+           match->draws * 100.0 / games);
+
+    if (match->sprt.enabled) {
+        const Sprt* sprt = &match->sprt;
+        double s0 = 1.0 / (1.0 + pow(10.0, -sprt->elo0 / 400.0));
+        double s1 = 1.0 / (1.0 + pow(10.0, -sprt->elo1 / 400.0));
+        double lower = log(sprt->beta / (1.0 - sprt->alpha));
+        double upper = log((1.0 - sprt->beta) / sprt->alpha);
+        double llr = variance > 0 ? games * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * variance) : 0.0;
+
+        if (llr >= upper) decision = 1;
+        if (llr <= lower) decision = -1;
+        printf("SPRT: llr %.2f (%.1f%%), lbound %.2f, ubound %.2f%s\n", llr, llr * 100.0 / upper, lower, upper,
+               decision > 0 ? " - H1 was accepted" : decision < 0 ? " - H0 was accepted" : "");
+    }
+    fflush(stdout);
+    return decision;
+}
+
+/**
+ * finishGame - counts, reports and writes out a finished game
+ */
+static void finishGame(Worker* worker, int game, const GameOutcome* outcome) {
+    Match* match = worker->match;
+    PgnGame* pgn = &worker->pgn;
+    const char* white = match->engines[game & 1].name;
+    const char* black = match->engines[!(game & 1)].name;
+    char round[16];
+
+    snprintf(pgn->result, sizeof(pgn->result), "%s",
+             outcome->winner == WHITE ? "1-0" : outcome->winner == BLACK ? "0-1" : "1/2-1/2");
+    snprintf(round, sizeof(round), "%d", game + 1);
+    pgnSetTag(pgn, "Event", "chess-match");
+    pgnSetTag(pgn, "Site", "?");
+    pgnSetTag(pgn, "Date", match->date);
+    pgnSetTag(pgn, "Round", round);
+    pgnSetTag(pgn, "White", white);
+    pgnSetTag(pgn, "Black", black);
+    pgnSetTag(pgn, "TimeControl", match->timeControl);
+    pgnSetTag(pgn, "Termination", outcome->termination);
+
+    pthread_mutex_lock(&match->lock);
+    match->finished++;
+    if (outcome->winner == NONE) {
+        match->draws++;
+    } else if ((outcome->winner == WHITE) == !(game & 1)) {
+        match->wins++;
+    } else {
+        match->losses++;
+    }
+    if (match->pgn) {
+        pgnWrite(match->pgn, pgn);
+        fflush(match->pgn);
+    }
+    printf("Finished game %d (%s vs %s): %s {%s}\n", game + 1, white, black, pgn->result, outcome->reason);
+    if (printScore(match) && !match->stop) {
+        match->stop = true;
+        printf("SPRT decided after %d games, finishing the games in progress\n", match->finished);
+    }
+    pthread_mutex_unlock(&match->lock);
+}
+
+static bool claimGame(Match* match, int* game) {
+    bool claimed;
+
+    pthread_mutex_lock(&match->lock);
+    claimed = !match->stop && match->nextGame < match->games;
+    if (claimed) *game = match->nextGame++;
+    pthread_mutex_unlock(&match->lock);
+    return claimed;
+}
+
+/**
+ * workerMain - plays games until none are left. Every worker runs its
+ * own pair of engines, so workers share nothing but the game counter,
+ * the score and the PGN file.
+ */
+static void* workerMain(void* arg) {
+    Worker* worker = arg;
+    Match* match = worker->match;
+    Position start;
+    int game;
+
+    for (int i = 0; i < 2; ++i) {
+        if (!playerStart(&worker->players[i], &match->engines[i])) {
+            fprintf(stderr, "chess-match: could not start engine %s\n", match->engines[i].name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    positionSetStart(&start);
+    recordInit(&worker->record, &start);
+    pgnGameInit(&worker->pgn);
+
+    while (claimGame(match, &game)) {
+        GameOutcome outcome = playGame(worker, game);
+
+        finishGame(worker, game, &outcome);
+    }
+
+    pgnGameFree(&worker->pgn);
+    recordFree(&worker->record);
+    playerQuit(&worker->players[0]);
+    playerQuit(&worker->players[1]);
+    return NULL;
+}
+
+static bool addOpening(Match* match, int* capacity, const Position* start, const Move* moves, int moveCount) {
+    Opening* opening;
+
+    if (match->openingCount == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 256;
+        Opening* openings = realloc(match->openings, (size_t)grown * sizeof(Opening));
+
+        if (!openings) return false;
+        match->openings = openings;
+        *capacity = grown;
+    }
+    opening = &match->openings[match->openingCount];
+    opening->start = *start;
+    opening->start.history = NULL;
+    opening->moveCount = moveCount;
+    opening->moves = NULL;
+    if (moveCount && !(opening->moves = malloc((size_t)moveCount * sizeof(Move)))) return false;
+    if (moveCount) memcpy(opening->moves, moves, (size_t)moveCount * sizeof(Move));
+    match->openingCount++;
+    return true;
+}
+
+/**
+ * loadOpenings - reads the suite: the games of a PGN file, cut to
+ * @plies moves when positive, or one FEN/EPD position per line.
+ * Entries that do not parse are reported and skipped.
+ */
+static bool loadOpenings(Match* match, const char* path, int plies) {
+    size_t length = strlen(path);
+    FILE* input = fopen(path, "r");
+    int capacity = 0;
+
+    if (!input) {
+        perror(path);
+        return false;
+    }
+
+    if (length > 4 && strcasecmp(path + length - 4, ".pgn") == 0) {
+        PgnReader reader;
+        PgnGame game;
+
+        if (!pgnReaderOpen(&reader, input)) {
+            fclose(input);
+            return false;
+        }
+        pgnGameInit(&game);
+        while (pgnRead(&reader, &game)) {
+            int count = (plies > 0 && game.moveCount > plies) ? plies : game.moveCount;
+
+            if (game.error[0]) {
+                fprintf(stderr, "%s: game at line %llu: %s\n", path, (unsigned long long)game.line, game.error);
+            } else if (!addOpening(match, &capacity, &game.start, game.moves, count)) {
+                break;
+            }
+        }
+        pgnGameFree(&game);
+        pgnReaderClose(&reader);
+    } else {
+        char line[1024];
+        uint64_t number = 0;
+
+        while (fgets(line, sizeof(line), input)) {
+            char* text = line;
+            const char* ops;
+            Position pos;
+
+            number++;
+            while (*text == ' ' || *text == '\t') text++;
+            text[strcspn(text, "\r\n")] = '\0';
+            if (!*text || *text == '#') continue;
+
+            ops = positionSetEpd(&pos, text);
+            if (ops && *ops >= '0' && *ops <= '9' && !positionSetFen(&pos, text)) ops = NULL;
+            if (!ops || positionInCheck(&pos, OPPONENT(pos.sideToMove))) {
+                fprintf(stderr, "%s:%llu: not a playable position\n", path, (unsigned long long)number);
+            } else if (!addOpening(match, &capacity, &pos, NULL, 0)) {
+                break;
+            }
+        }
+    }
+    fclose(input);
+    return match->openingCount > 0;
+}
+
+int main(int argc, char** argv) {
+    static Match match;
+    const char *openingsPath = NULL, *pgnPath = NULL;
+    char bitbasePath[BITBASE_PATH_MAX];
+    long long concurrency = 0, plies = 0, value;
+    int engineCount = 0, maxThreads = 1;
+    Worker* workers;
+    double numbers[4];
+    time_t now = time(NULL);
+    int64_t start;
+
+    match.games = MATCH_DEFAULT_GAMES;
+    match.adjudication.maxMoves = MATCH_DEFAULT_MAX_MOVES;
+    snprintf(match.timeControl, sizeof(match.timeControl), "-");
+    for (int i = 0; i < 2; ++i) {
+        snprintf(match.engines[i].name, sizeof(match.engines[i].name), "engine%d", i + 1);
+        match.engines[i].hashMb = MATCH_DEFAULT_HASH_MB;
+        match.engines[i].threads = 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : "";
+        bool ok = true;
+
+        if (strcmp(arg, "--engine") == 0 && engineCount < 2) {
+            ok = parseEngine(&match.engines[engineCount++], next);
+        } else if (strcmp(arg, "--tc") == 0 && parseClock(next, &numbers[0], &numbers[1])) {
+            memset(&match.limits, 0, sizeof(match.limits));
+            match.limits.time[WHITE] = match.limits.time[BLACK] = (int64_t)(numbers[0] * 1000.0);
+            match.limits.increment[WHITE] = match.limits.increment[BLACK] = (int64_t)(numbers[1] * 1000.0);
+            snprintf(match.timeControl, sizeof(match.timeControl), "%s", next);
+        } else if (strcmp(arg, "--movetime") == 0 && parseCount(next, 1, &value)) {
+            memset(&match.limits, 0, sizeof(match.limits));
+            match.limits.moveTime = value;
+            snprintf(match.timeControl, sizeof(match.timeControl), "-");
+        } else if (strcmp(arg, "--depth") == 0 && parseCount(next, 1, &value) && value < MAX_PLY) {
+            memset(&match.limits, 0, sizeof(match.limits));
+            match.limits.depth = (int)value;
+            snprintf(match.timeControl, sizeof(match.timeControl), "-");
+        } else if (strcmp(arg, "--nodes") == 0 && parseCount(next, 1, &value)) {
+            memset(&match.limits, 0, sizeof(match.limits));
+            match.limits.nodes = (uint64_t)value;
+            snprintf(match.timeControl, sizeof(match.timeControl), "-");
+        } else if (strcmp(arg, "--games") == 0 && parseCount(next, 1, &value) && value <= 1000000000) {
+            match.games = (int)value;
+        } else if (strcmp(arg, "--concurrency") == 0 && parseCount(next, 1, &value)) {
+            concurrency = value;
+        } else if (strcmp(arg, "--openings") == 0 && *next) {
+            openingsPath = next;
+        } else if (strcmp(arg, "--plies") == 0 && parseCount(next, 1, &value)) {
+            plies = value;
+        } else if (strcmp(arg, "--pgn") == 0 && *next) {
+            pgnPath = next;
+        } else if (strcmp(arg, "--sprt") == 0) {
+            int read = parseNumbers(next, numbers, 4);
+
+            match.sprt.alpha = match.sprt.beta = 0.05;
+            ok = read == 2 || read == 4;
+            if (ok) {
+                match.sprt.elo0 = numbers[0];
+                match.sprt.elo1 = numbers[1];
+                if (read == 4) {
+                    match.sprt.alpha = numbers[2];
+                    match.sprt.beta = numbers[3];
+                }
+                match.sprt.enabled = true;
+                ok = match.sprt.elo1 > match.sprt.elo0 && match.sprt.alpha > 0 && match.sprt.alpha < 1
+                  && match.sprt.beta > 0 && match.sprt.beta < 1;
+            }
+        } else if (strcmp(arg, "--draw") == 0) {
+            ok = parseNumbers(next, numbers, 3) == 3 && numbers[0] >= 0 && numbers[1] >= 1 && numbers[2] >= 0;
+            match.adjudication.drawMoveNumber = (int)numbers[0];
+            match.adjudication.drawMoveCount = (int)numbers[1];
+            match.adjudication.drawScore = (int)numbers[2];
+        } else if (strcmp(arg, "--resign") == 0) {
+            ok = parseNumbers(next, numbers, 2) == 2 && numbers[0] >= 1 && numbers[1] >= 0;
+            match.adjudication.resignMoveCount = (int)numbers[0];
+            match.adjudication.resignScore = (int)numbers[1];
+        } else if (strcmp(arg, "--maxmoves") == 0 && parseCount(next, 0, &value) && value <= 100000) {
+            match.adjudication.maxMoves = (int)value;
+        } else if (strcmp(arg, "--bitbases") == 0) {
+            match.adjudication.bitbases = true;
+            continue;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (engineCount != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!match.limits.time[WHITE] && !match.limits.moveTime && !match.limits.depth && !match.limits.nodes) {
+        for (int i = 0; i < 2; ++i) {
+            if (!match.engines[i].depth && !match.engines[i].nodes) {
+                fprintf(stderr, "chess-match: %s has no time control, give --tc, --movetime, --depth or --nodes\n",
+                        match.engines[i].name);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    chessCoreInit();
+    if (openingsPath && !loadOpenings(&match, openingsPath, (int)plies)) {
+        fprintf(stderr, "chess-match: no openings in %s\n", openingsPath);
+        return EXIT_FAILURE;
+    }
+    if (!openingsPath) {
+        Position initial;
+
+        positionSetStart(&initial);
+        match.openings = malloc(sizeof(Opening));
+        if (!match.openings) return EXIT_FAILURE;
+        match.openings[0] = (Opening){initial, NULL, 0};
+        match.openingCount = 1;
+    }
+    if (pgnPath && !(match.pgn = fopen(pgnPath, "w"))) {
+        perror(pgnPath);
+        return EXIT_FAILURE;
+    }
+
+    /* Every game occupies as many cores as its engines search with */
+    for (int i = 0; i < 2; ++i) {
+        if (match.engines[i].threads > maxThreads) maxThreads = match.engines[i].threads;
+    }
+    if (!concurrency) concurrency = sysconf(_SC_NPROCESSORS_ONLN) / maxThreads;
+    if (concurrency < 1) concurrency = 1;
+    if (concurrency > match.games) concurrency = match.games;
+
+    if (!bitbaseDefaultPath(bitbasePath, sizeof(bitbasePath))
+        || !bitbaseInit(bitbasePath, (int)(concurrency * maxThreads))) {
+        fprintf(stderr, "chess-match: bitbases unavailable\n");
+        match.adjudication.bitbases = false;
+    }
+    strftime(match.date, sizeof(match.date), "%Y.%m.%d", localtime(&now));
+    signal(SIGPIPE, SIG_IGN);
+    pthread_mutex_init(&match.lock, NULL);
+    workers = calloc((size_t)concurrency, sizeof(Worker));
+    if (!workers) {
+        fprintf(stderr, "chess-match: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Started %s vs %s: %d games, %lld at a time, %d opening%s\n", match.engines[0].name,
+           match.engines[1].name, match.games, concurrency, match.openingCount, match.openingCount == 1 ? "" : "s");
+    fflush(stdout);
+    start = timeNowMs();
+    for (long long i = 0; i < concurrency; ++i) {
+        pthread_attr_t attr;
+
+        workers[i].match = &match;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, SEARCH_STACK_SIZE);
+        workers[i].started = pthread_create(&workers[i].handle, &attr, workerMain, &workers[i]) == 0;
+        pthread_attr_destroy(&attr);
+        if (!workers[i].started) {
+            fprintf(stderr, "chess-match: started only %lld of %lld workers\n", i, concurrency);
+            if (i == 0) return EXIT_FAILURE;
+            break;
+        }
+    }
+    for (long long i = 0; i < concurrency; ++i) {
+        if (workers[i].started) pthread_join(workers[i].handle, NULL);
+    }
+
+    printf("Finished match: %d games in %.1f s\n", match.finished, (double)(timeNowMs() - start) / 1000.0);
+    if (match.pgn) fclose(match.pgn);
+    for (int i = 0; i < match.openingCount; ++i) free(match.openings[i].moves);
+    free(match.openings);
+    free(workers);
+    bitbaseFree();
+    pthread_mutex_destroy(&match.lock);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eval.h"
+#include "misc.h"
+#include "movegen.h"
+#include "nnue.h"
+
+#define BENCH_SEED 0x9E3779B97F4A7C15ULL
+#define BENCH_POSITIONS 1024
+#define REFRESH_ROUNDS 100
+#define PLAYOUT_GAMES 64
+#define PLAYOUT_PLIES 160
+
+/**
+ * BenchResult - one path's figures; the checksums fold in every score
+ * it produced, so paths that disagree anywhere are caught
+ */
+typedef struct {
+    uint64_t refreshEvals;
+    int64_t refreshMs;
+    uint64_t incrementalEvals;
+    int64_t incrementalMs;
+    uint64_t checksum;
+} BenchResult;
+
+static NnueAccumulator Stack[PLAYOUT_PLIES + 2];
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s bench [network]         evaluations per second of every SIMD path this\n"
+            "                                       machine supports (a random network without a file)\n"
+            "       %s random <file> [seed]    write an untrained network of random weights\n"
+            "       %s eval <network> [fen]    network and classic scores of a position\n",
+            program, program, program);
+}
+
+static uint64_t fold(uint64_t checksum, int value) {
+    return (checksum ^ (uint64_t)(uint32_t)value) * 0x100000001B3ULL;
+}
+
+/* Positions from random games, sampled every few plies */
+static int collectPositions(Position* positions, int capacity) {
+    uint64_t seed = BENCH_SEED;
+    int count = 0;
+
+    while (count < capacity) {
+        Position pos;
+        UndoInfo undo[PLAYOUT_PLIES];
+        MoveList list;
+
+        positionSetStart(&pos);
+        for (int ply = 0; ply < PLAYOUT_PLIES && count < capacity; ++ply) {
+            if (generateLegalMoves(&pos, &list) == 0) break;
+            positionMakeMove(&pos, list.moves[randomNext(&seed) % (uint64_t)list.count], &undo[ply]);
+            if (ply % 4 == 3) {
+                positions[count] = pos;
+                positions[count++].history = NULL;
+            }
+        }
+    }
+    return count;
+}
+
+static void benchRefresh(const Position* positions, int count, BenchResult* result) {
+    NnueAccumulator* root = &Stack[0];
+    int64_t start = timeNowMs();
+
+    for (int round = 0; round < REFRESH_ROUNDS; ++round) {
+        for (int i = 0; i < count; ++i) {
+            Position pos = positions[i];
+
+            pos.nnue = root;
+            nnueReset(root);
+            result->checksum = fold(result->checksum, nnueEvaluate(&pos));
+        }
+    }
+    result->refreshMs = timeNowMs() - start;
+    result->refreshEvals = (uint64_t)count * REFRESH_ROUNDS;
+}
+
+/**
+ * benchIncremental - random games in which every legal move is made,
+ * evaluated and taken back before one of them is played, like the
+ * leaves of a search. With @mismatches each score is also checked
+ * against a network computed from scratch.
+ */
+static void benchIncremental(BenchResult* result, uint64_t* mismatches) {
+    uint64_t seed = BENCH_SEED;
+    int64_t start = timeNowMs();
+    NnueAccumulator fresh;
+
+    for (int game = 0; game < PLAYOUT_GAMES; ++game) {
+        Position pos;
+        UndoInfo undo[PLAYOUT_PLIES];
+        MoveList list;
+
+        positionSetStart(&pos);
+        pos.nnue = Stack;
+        nnueReset(Stack);
+        for (int ply = 0; ply < PLAYOUT_PLIES; ++ply) {
+            result->checksum = fold(result->checksum, nnueEvaluate(&pos));
+            result->incrementalEvals++;
+            if (generateLegalMoves(&pos, &list) == 0) break;
+
+            for (int i = 0; i < list.count; ++i) {
+                UndoInfo childUndo;
+                int value;
+
+                positionMakeMove(&pos, list.moves[i], &childUndo);
+                value = nnueEvaluate(&pos);
+                result->checksum = fold(result->checksum, value);
+                result->incrementalEvals++;
+                if (mismatches) {
+                    Position copy = pos;
+
+                    copy.nnue = &fresh;
+                    nnueReset(&fresh);
+                    if (nnueEvaluate(&copy) != value) ++*mismatches;
+                }
+                positionUnmakeMove(&pos, list.moves[i], &childUndo);
+            }
+            positionMakeMove(&pos, list.moves[randomNext(&seed) % (uint64_t)list.count], &undo[ply]);
+        }
+    }
+    result->incrementalMs = timeNowMs() - start;
+}
+
+static double perSecond(uint64_t count, int64_t ms) {
+    return (double)count * 1000.0 / (double)(ms > 0 ? ms : 1);
+}
+
+static int runBench(const char* path) {
+    static Position positions[BENCH_POSITIONS];
+    int count = collectPositions(positions, BENCH_POSITIONS);
+    BenchResult results[NNUE_SIMD_NB] = {{0}};
+    NnueSimd best = nnueGetSimd();
+    uint64_t mismatches = 0, sink = 0;
+    bool agree = true;
+    int64_t start, elapsed;
+
+    if (path ? !nnueLoad(path) : !nnueRandomize(BENCH_SEED)) {
+        fprintf(stderr, "chess-nnue: could not %s network %s\n", path ? "load" : "allocate", path ? path : "");
+        return EXIT_FAILURE;
+    }
+    printf("network %s, %d positions x %d rounds from scratch, %d playouts of up to %d plies\n",
+           path ? path : "random", count, REFRESH_ROUNDS, PLAYOUT_GAMES, PLAYOUT_PLIES);
+
+    /* Incremental updates are checked against full refreshes once, on
+     * the reference path, outside the timed runs */
+    nnueSetSimd(NNUE_SCALAR);
+    benchIncremental(&(BenchResult){0}, &mismatches);
+
+    for (int simd = NNUE_SCALAR; simd < NNUE_SIMD_NB; ++simd) {
+        BenchResult* result = &results[simd];
+
+        if (!nnueSetSimd((NnueSimd)simd)) {
+            printf("%-8s not supported here\n", nnueSimdName((NnueSimd)simd));
+            continue;
+        }
+        benchRefresh(positions, count, result);
+        benchIncremental(result, NULL);
+        agree = agree && result->checksum == results[NNUE_SCALAR].checksum;
+        printf("%-8s refresh %10.0f evals/s   incremental %10.0f evals/s   checksum %016llx%s\n",
+               nnueSimdName((NnueSimd)simd), perSecond(result->refreshEvals, result->refreshMs),
+               perSecond(result->incrementalEvals, result->incrementalMs), (unsigned long long)result->checksum,
+               result->checksum == results[NNUE_SCALAR].checksum ? "" : "  MISMATCH");
+    }
+    nnueSetSimd(best);
+
+    start = timeNowMs();
+    for (int round = 0; round < REFRESH_ROUNDS; ++round) {
+        for (int i = 0; i < count; ++i) sink += (uint64_t)evaluate(&positions[i], NULL);
+    }
+    elapsed = timeNowMs() - start;
+    printf("%-8s         %10.0f evals/s   (handcrafted evaluation, for reference)\n", "classic",
+           perSecond((uint64_t)count * REFRESH_ROUNDS, elapsed));
+    printf("incremental updates checked against refreshes: %llu mismatches\n", (unsigned long long)mismatches);
+    (void)sink;
+
+    nnueFree();
+    return agree && mismatches == 0 ? EXIT_SUCCESS : 2;
+}
+
+static int runEval(const char* path, const char* fen) {
+    NnueAccumulator root;
+    Position pos;
+
+    if (!nnueLoad(path)) {
+        fprintf(stderr, "chess-nnue: could not load network %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (!positionSetFen(&pos, fen)) {
+        fprintf(stderr, "chess-nnue: invalid FEN %s\n", fen);
+        nnueFree();
+        return EXIT_FAILURE;
+    }
+    printf("classic %d\n", evaluate(&pos, NULL));
+    pos.nnue = &root;
+    nnueReset(&root);
+    printf("network %d (%s)\n", nnueEvaluate(&pos), nnueSimdName(nnueGetSimd()));
+    nnueFree();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * main - benchmarks, writes and tries out evaluation networks
+ *
+ * Return: 0 on success, 2 if the SIMD paths or the incremental updates
+ *         disagree, otherwise 1
+ */
+int main(int argc, char** argv) {
+    chessCoreInit();
+
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "bench") == 0) {
+        return runBench(argc == 3 ? argv[2] : NULL);
+    }
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "random") == 0) {
+        uint64_t seed = argc == 4 ? strtoull(argv[3], NULL, 0) : BENCH_SEED;
+
+        if (!nnueRandomize(seed) || !nnueSave(argv[2])) {
+            perror(argv[2]);
+            return EXIT_FAILURE;
+        }
+        nnueFree();
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "eval") == 0) {
+        return runEval(argv[2], argc == 4 ? argv[3] : START_FEN);
+    }
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
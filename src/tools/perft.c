@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "movegen.h"
+#include "misc.h"
+
+#define MAX_PERFT_DEPTH 8
+
+typedef struct {
+    const char* name;
+    const char* fen;
+    uint64_t nodes[MAX_PERFT_DEPTH];  /** nodes[d - 1] is the count at depth d */
+} PerftCase;
+
+/* Reference counts from the standard perft positions (chessprogramming
+ * wiki) and the common talkchess edge-case collection; 0 = not listed */
+static const PerftCase benchSuite[] = {
+    {"startpos", START_FEN,
+        {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        {48, 2039, 97862, 4085603, 193690690}},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        {6, 264, 9467, 422333, 15833292}},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        {44, 1486, 62379, 2103487, 89941194}},
+    {"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        {46, 2079, 89890, 3894594, 164075551}},
+    {"illegal ep 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1",
+        {0, 0, 0, 0, 0, 1134888}},
+    {"illegal ep 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+        {0, 0, 0, 0, 0, 1015133}},
+    {"ep capture checks", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+        {0, 0, 0, 0, 0, 1440467}},
+    {"short castle check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+        {0, 0, 0, 0, 0, 661072}},
+    {"long castle check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",
+        {0, 0, 0, 0, 0, 803711}},
+    {"castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1",
+        {0, 0, 0, 1274206}},
+    {"castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+        {0, 0, 0, 1720476}},
+    {"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+        {0, 0, 0, 0, 0, 3821001}},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1",
+        {0, 0, 0, 0, 1004658}},
+    {"promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1",
+        {0, 0, 0, 0, 0, 217342}},
+    {"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1",
+        {0, 0, 0, 0, 0, 92683}},
+    {"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1",
+        {0, 0, 0, 0, 0, 2217}},
+    {"stalemate and checkmate 1", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1",
+        {0, 0, 0, 0, 0, 0, 567584}},
+    {"stalemate and checkmate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1",
+        {0, 0, 0, 23527}},
+};
+
+#define BENCH_SIZE ((int)(sizeof(benchSuite) / sizeof(benchSuite[0])))
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [-d] <depth> [fen]   count leaf nodes, -d prints per-move counts\n"
+            "       %s bench [max-depth]    run the reference suite (default max depth 5)\n",
+            program, program);
+}
+
+static uint64_t nodesPerSecond(uint64_t nodes, int64_t elapsedMs) {
+    return nodes * 1000 / (uint64_t)(elapsedMs > 0 ? elapsedMs : 1);
+}
+
+static uint64_t divide(Position* pos, int depth) {
+    MoveList list;
+    UndoInfo undo;
+    uint64_t total = 0;
+    char buffer[6];
+
+    generateLegalMoves(pos, &list);
+    for (int i = 0; i < list.count; ++i) {
+        uint64_t nodes;
+
+        positionMakeMove(pos, list.moves[i], &undo);
+        nodes = perft(pos, depth - 1);
+        positionUnmakeMove(pos, list.moves[i], &undo);
+        total += nodes;
+        printf("%s: %llu\n", moveToString(list.moves[i], buffer), (unsigned long long)nodes);
+    }
+    printf("\nmoves: %d\n", list.count);
+    return total;
+}
+
+static int runPerft(const char* fen, int depth, int showDivide) {
+    Position pos;
+    int64_t start;
+    uint64_t nodes;
+    int64_t elapsed;
+
+    if (!positionSetFen(&pos, fen)) {
+        fprintf(stderr, "invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    if (showDivide) {
+        start = timeNowMs();
+        nodes = divide(&pos, depth);
+        elapsed = timeNowMs() - start;
+        printf("nodes: %llu\ntime: %lld ms\nnps: %llu\n", (unsigned long long)nodes,
+               (long long)elapsed, (unsigned long long)nodesPerSecond(nodes, elapsed));
+        return 0;
+    }
+
+    for (int d = 1; d <= depth; ++d) {
+        start = timeNowMs();
+        nodes = perft(&pos, d);
+        elapsed = timeNowMs() - start;
+        printf("depth %d nodes %llu time %lld ms nps %llu\n", d, (unsigned long long)nodes,
+               (long long)elapsed, (unsigned long long)nodesPerSecond(nodes, elapsed));
+    }
+    return 0;
+}
+
+/**
+ * runBench - perfts every suite position at the deepest listed depth not
+ * above @maxDepth and checks the count against the reference
+ *
+ * Return: number of positions whose count did not match
+ */
+static int runBench(int maxDepth) {
+    uint64_t totalNodes = 0;
+    int64_t totalTime = 0;
+    int failures = 0, run = 0;
+
+    for (int i = 0; i < BENCH_SIZE; ++i) {
+        const PerftCase* test = &benchSuite[i];
+        Position pos;
+        int depth = 0;
+
+        for (int d = 1; d <= maxDepth && d <= MAX_PERFT_DEPTH; ++d) {
+            if (test->nodes[d - 1]) depth = d;
+        }
+        if (depth == 0) {
+            printf("%-26s skipped (no reference count up to depth %d)\n", test->name, maxDepth);
+            continue;
+        }
+        if (!positionSetFen(&pos, test->fen)) {
+            printf("%-26s invalid FEN\n", test->name);
+            failures++;
+            continue;
+        }
+
+        int64_t start = timeNowMs();
+        uint64_t nodes = perft(&pos, depth);
+        int64_t elapsed = timeNowMs() - start;
+        int ok = nodes == test->nodes[depth - 1];
+
+        printf("%-26s depth %d nodes %12llu expected %12llu %s %6lld ms %10llu nps\n",
+               test->name, depth, (unsigned long long)nodes, (unsigned long long)test->nodes[depth - 1],
+               ok ? "ok  " : "FAIL", (long long)elapsed, (unsigned long long)nodesPerSecond(nodes, elapsed));
+        failures += !ok;
+        totalNodes += nodes;
+        totalTime += elapsed;
+        run++;
+    }
+
+    printf("\n%d positions, %d failed, %llu nodes, %lld ms, %llu nps\n", run, failures,
+           (unsigned long long)totalNodes, (long long)totalTime,
+           (unsigned long long)nodesPerSecond(totalNodes, totalTime));
+    return failures;
+}
+
+/**
+ * main - headless perft driver
+ *
+ * Return: 0 on success (all bench counts matching),
+ *         otherwise 1 (failure)
+ */
+int main(int argc, char** argv) {
+    int showDivide = 0;
+    int arg = 1;
+
+    chessCoreInit();
+
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        int maxDepth = (argc >= 3) ? atoi(argv[2]) : 5;
+        return runBench(maxDepth) ? 1 : 0;
+    }
+
+    if (arg < argc && strcmp(argv[arg], "-d") == 0) {
+        showDivide = 1;
+        arg++;
+    }
+    if (arg >= argc || atoi(argv[arg]) < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int depth = atoi(argv[arg++]);
+    const char* fen = (arg < argc) ? argv[arg] : START_FEN;
+    return runPerft(fen, depth, showDivide);
+}
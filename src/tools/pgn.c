@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "movegen.h"
+#include "pgn.h"
+
+/**
+ * PgnStats - what a pass over the input found
+ */
+typedef struct {
+    uint64_t games;
+    uint64_t errors;
+    uint64_t plies;
+    uint64_t bytes;
+    uint64_t results[4];    /** white wins, black wins, draws, unfinished */
+    uint64_t checkmates;    /** games whose last move mates */
+    int longest;
+} PgnStats;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--output FILE] [--quiet] [games.pgn ...]\n"
+            "Reads PGN games (standard input without files, or for \"-\"),\n"
+            "replays every move through the rules and reports what it found.\n"
+            "  --output FILE  write the games that replay cleanly back out in\n"
+            "                 export format\n"
+            "  --quiet        do not report each game with an illegal move\n"
+            "Exits with status 2 if any game could not be replayed.\n",
+            program);
+}
+
+static int resultIndex(const char* result) {
+    if (strcmp(result, "1-0") == 0) return 0;
+    if (strcmp(result, "0-1") == 0) return 1;
+    if (strcmp(result, "1/2-1/2") == 0) return 2;
+    return 3;
+}
+
+static bool readFile(const char* path, FILE* output, bool quiet, PgnStats* stats) {
+    FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    PgnReader reader;
+    PgnGame game;
+
+    if (!input) {
+        perror(path);
+        return false;
+    }
+    if (!pgnReaderOpen(&reader, input)) {
+        fprintf(stderr, "chess-pgn: out of memory\n");
+        return false;
+    }
+    pgnGameInit(&game);
+
+    while (pgnRead(&reader, &game)) {
+        stats->games++;
+        stats->plies += (uint64_t)game.moveCount;
+        stats->results[resultIndex(game.result)]++;
+        if (game.moveCount > stats->longest) stats->longest = game.moveCount;
+        if (game.error[0]) {
+            stats->errors++;
+            if (!quiet) fprintf(stderr, "%s: game at line %llu: %s\n", path, (unsigned long long)game.line, game.error);
+            continue;
+        }
+        if (positionIsCheckMate(&game.end)) stats->checkmates++;
+        if (output) pgnWrite(output, &game);
+    }
+
+    stats->bytes += reader.bytes;
+    pgnGameFree(&game);
+    pgnReaderClose(&reader);
+    if (input != stdin) fclose(input);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = NULL;
+    const char** inputs = calloc((size_t)argc + 1, sizeof(char*));
+    int inputCount = 0;
+    bool quiet = false, ok = true;
+    PgnStats stats = {0};
+    FILE* output = NULL;
+    int64_t start, elapsed;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            inputs[inputCount++] = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (inputCount == 0) inputs[inputCount++] = "-";
+    if (outputPath && !(output = fopen(outputPath, "w"))) {
+        perror(outputPath);
+        return EXIT_FAILURE;
+    }
+
+    chessCoreInit();
+    start = timeNowMs();
+    for (int i = 0; i < inputCount; ++i) {
+        ok = readFile(inputs[i], output, quiet, &stats) && ok;
+    }
+    elapsed = timeNowMs() - start;
+    if (output) fclose(output);
+    free(inputs);
+
+    fprintf(stderr, "chess-pgn: %llu games, %llu with errors, %llu plies (longest %d, mean %.1f)\n",
+            (unsigned long long)stats.games, (unsigned long long)stats.errors, (unsigned long long)stats.plies,
+            stats.longest, stats.games ? (double)stats.plies / (double)stats.games : 0.0);
+    fprintf(stderr, "chess-pgn: results 1-0 %llu, 0-1 %llu, 1/2-1/2 %llu, * %llu; %llu end in mate\n",
+            (unsigned long long)stats.results[0], (unsigned long long)stats.results[1],
+            (unsigned long long)stats.results[2], (unsigned long long)stats.results[3],
+            (unsigned long long)stats.checkmates);
+    fprintf(stderr, "chess-pgn: %.1f MB in %lld ms (%.1f MB/s, %.0f games/s, %.0f plies/s)\n",
+            (double)stats.bytes / 1e6, (long long)elapsed,
+            (double)stats.bytes / 1e3 / (double)(elapsed > 0 ? elapsed : 1),
+            (double)stats.games * 1000.0 / (double)(elapsed > 0 ? elapsed : 1),
+            (double)stats.plies * 1000.0 / (double)(elapsed > 0 ? elapsed : 1));
+
+    if (!ok) return EXIT_FAILURE;
+    return stats.errors ? 2 : EXIT_SUCCESS;
+}
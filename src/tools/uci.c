@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "bitbase.h"
+#include "book.h"
+#include "eval.h"
+#include "misc.h"
+#include "nnue.h"
+#include "record.h"
+#include "search.h"
+#include "stats.h"
+
+#define ENGINE_NAME "chess-engine-c"
+#define ENGINE_AUTHOR "Kinyarasam"
+#define SEARCH_STACK_SIZE (8 * 1024 * 1024)
+#define BENCH_DEPTH 6
+#define EVAL_BENCH_ROUNDS 2000
+
+static const char* const BenchFens[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+    "2r3k1/5pp1/p3p2p/1p1qP3/3P4/P4Q2/1P3PPP/2R3K1 w - - 0 28",
+    "8/8/1p3k2/p1p2p2/P1P2P2/1P3K2/8/8 w - - 0 45",
+};
+
+#define BENCH_SIZE ((int)(sizeof(BenchFens) / sizeof(BenchFens[0])))
+
+/**
+ * UciState - the engine as seen by the protocol loop. The main thread
+ * only reads stdin; searches run on searchThread so "stop" and
+ * "isready" are answered while the engine thinks.
+ */
+typedef struct {
+    Position root;
+    Position pos;
+    GameRecord record;      /** the moves from root to pos */
+
+    Search search;
+    TransTable tt;
+    SearchLimits limits;
+
+    Book book;
+    bool ownBook;
+    uint64_t bookSeed;
+
+    pthread_t searchThread;
+    bool searching;
+    bool stopRequested;
+    pthread_mutex_t lock;
+    pthread_cond_t stopped;
+} UciState;
+
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void uciPrintf(const char* format, ...) {
+    va_list args;
+
+    pthread_mutex_lock(&outputLock);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+    pthread_mutex_unlock(&outputLock);
+}
+
+/**
+ * printStats - the instrumentation counters as "info string stats"
+ * lines, or as one JSON object with @json
+ */
+static void printStats(bool json) {
+    Stats stats;
+    char buffer[1024];
+    size_t length = 0;
+
+    if (!STATS_ENABLED) {
+        uciPrintf("info string stats not compiled in, configure with -DCHESS_STATS=ON\n");
+        return;
+    }
+    statsCollect(&stats);
+    if (json) {
+        statsFormatJson(&stats, buffer, sizeof(buffer));
+        uciPrintf("info string stats %s\n", buffer);
+        return;
+    }
+    for (int i = 0; i < STAT_NB; ++i) {
+        length += (size_t)snprintf(buffer + length, sizeof(buffer) - length, " %s %llu", statsName((StatId)i),
+                                   (unsigned long long)stats.counters[i]);
+    }
+    uciPrintf("info string stats%s\n", buffer);
+    length = 0;
+    for (int i = 0; i < STATS_CUTOFF_SLOTS; ++i) {
+        length += (size_t)snprintf(buffer + length, sizeof(buffer) - length, " %llu",
+                                   (unsigned long long)stats.cutoffAt[i]);
+    }
+    uciPrintf("info string stats cutoff_at%s\n", buffer);
+}
+
+static void formatScore(int score, char* buffer, size_t size) {
+    if (score >= VALUE_MATE_IN_MAX_PLY) {
+        snprintf(buffer, size, "mate %d", (VALUE_MATE - score + 1) / 2);
+    } else if (score <= -VALUE_MATE_IN_MAX_PLY) {
+        snprintf(buffer, size, "mate %d", -(VALUE_MATE + score) / 2);
+    } else {
+        snprintf(buffer, size, "cp %d", score);
+    }
+}
+
+static void onIteration(const SearchInfo* info, void* userData) {
+    UciState* uci = userData;
+    char score[24], pv[MAX_PLY * 6 + 1] = "", move[6];
+    bool stop;
+
+    /* searchRun drops a stop that came before it started; repeat it */
+    pthread_mutex_lock(&uci->lock);
+    stop = uci->stopRequested;
+    pthread_mutex_unlock(&uci->lock);
+    if (stop) searchStop(&uci->search);
+
+    formatScore(info->score, score, sizeof(score));
+    for (int i = 0; i < info->pvLength; ++i) {
+        strcat(pv, " ");
+        strcat(pv, moveToString(info->pv[i], move));
+    }
+    uciPrintf("info depth %d score %s nodes %llu nps %llu time %lld hashfull %d pv%s\n",
+              info->depth, score, (unsigned long long)info->nodes, (unsigned long long)info->nps,
+              (long long)info->elapsedMs, info->hashfull, pv);
+}
+
+static void* searchMain(void* arg) {
+    UciState* uci = arg;
+    SearchInfo result;
+    char move[6];
+    Move best = searchRun(&uci->search, &uci->pos, &uci->limits, &result);
+
+    for (int i = 0; i < uci->search.threadCount; ++i) {
+        const SearchThread* thread = &uci->search.threads[i];
+        uciPrintf("info string thread %d nodes %llu depth %d pawnhash %llu/%llu hits\n", i,
+                  (unsigned long long)thread->nodes, thread->completedDepth,
+                  (unsigned long long)thread->pawns.hits, (unsigned long long)thread->pawns.probes);
+    }
+    uciPrintf("info string total nodes %llu time %lld nps %llu\n", (unsigned long long)result.nodes,
+              (long long)result.elapsedMs, (unsigned long long)result.nps);
+    if (STATS_ENABLED) printStats(false);
+
+    /* UCI: after "go infinite" bestmove may only be sent once stopped */
+    pthread_mutex_lock(&uci->lock);
+    while (uci->limits.infinite && !uci->stopRequested) {
+        pthread_cond_wait(&uci->stopped, &uci->lock);
+    }
+    pthread_mutex_unlock(&uci->lock);
+
+    uciPrintf("bestmove %s\n", best != MOVE_NONE ? moveToString(best, move) : "0000");
+    return NULL;
+}
+
+static void stopSearch(UciState* uci) {
+    if (!uci->searching) return;
+
+    pthread_mutex_lock(&uci->lock);
+    uci->stopRequested = true;
+    pthread_cond_signal(&uci->stopped);
+    pthread_mutex_unlock(&uci->lock);
+
+    searchStop(&uci->search);
+    pthread_join(uci->searchThread, NULL);
+    uci->searching = false;
+}
+
+static void handlePosition(UciState* uci, char* args) {
+    char* saveptr = NULL;
+    char* token = strtok_r(args, " \t", &saveptr);
+    char* moves = NULL;
+
+    if (!token) return;
+    if (strcmp(token, "startpos") == 0) {
+        positionSetStart(&uci->root);
+        token = strtok_r(NULL, " \t", &saveptr);
+    } else if (strcmp(token, "fen") == 0) {
+        char fen[256] = "";
+        while ((token = strtok_r(NULL, " \t", &saveptr)) && strcmp(token, "moves") != 0) {
+            strncat(fen, token, sizeof(fen) - strlen(fen) - 2);
+            strcat(fen, " ");
+        }
+        if (!positionSetFen(&uci->root, fen)) {
+            uciPrintf("info string invalid fen %s\n", fen);
+            positionSetStart(&uci->root);
+        }
+    } else {
+        return;
+    }
+
+    uci->pos = uci->root;
+    recordReset(&uci->record, &uci->root);
+    if (token && strcmp(token, "moves") == 0) moves = token;
+    while (moves && (token = strtok_r(NULL, " \t", &saveptr))) {
+        Move move = moveFromString(&uci->pos, token);
+        if (move == MOVE_NONE || !recordPlay(&uci->record, &uci->pos, move)) {
+            uciPrintf("info string illegal move %s\n", token);
+            break;
+        }
+    }
+}
+
+/* The value after a "go" keyword that takes one ("mate" is read but
+ * searched like any other position); NULL for other keywords */
+static char* goValue(const char* keyword, char** saveptr) {
+    static const char* const withValue[] = {"depth", "nodes", "movetime", "wtime", "btime",
+                                            "winc", "binc", "movestogo", "mate"};
+
+    for (size_t i = 0; i < sizeof(withValue) / sizeof(withValue[0]); ++i) {
+        if (strcmp(keyword, withValue[i]) == 0) return strtok_r(NULL, " \t", saveptr);
+    }
+    return NULL;
+}
+
+static void handleGo(UciState* uci, char* args) {
+    char* saveptr = NULL;
+    char* token;
+    SearchLimits limits = {0};
+    pthread_attr_t attr;
+    bool searchMoves = false;
+    char move[6];
+    Move best;
+
+    /* Only keywords known to take a value consume the next token, so an
+     * unknown one cannot shift the pairs after it */
+    while ((token = strtok_r(args, " \t", &saveptr))) {
+        char* value;
+        args = NULL;
+
+        /* The searchmoves list runs up to the next token that is not a
+         * legal move; the root is always searched in full */
+        if (searchMoves && moveFromString(&uci->pos, token) != MOVE_NONE) continue;
+        searchMoves = false;
+
+        /* Pondering searches until "ponderhit" or "stop" */
+        if (strcmp(token, "infinite") == 0 || strcmp(token, "ponder") == 0) limits.infinite = true;
+        else if (strcmp(token, "searchmoves") == 0) searchMoves = true;
+        else if (!(value = goValue(token, &saveptr))) continue;
+        else if (strcmp(token, "depth") == 0) limits.depth = atoi(value);
+        else if (strcmp(token, "nodes") == 0) limits.nodes = strtoull(value, NULL, 10);
+        else if (strcmp(token, "movetime") == 0) limits.moveTime = atoll(value);
+        else if (strcmp(token, "wtime") == 0) limits.time[WHITE] = atoll(value);
+        else if (strcmp(token, "btime") == 0) limits.time[BLACK] = atoll(value);
+        else if (strcmp(token, "winc") == 0) limits.increment[WHITE] = atoll(value);
+        else if (strcmp(token, "binc") == 0) limits.increment[BLACK] = atoll(value);
+        else if (strcmp(token, "movestogo") == 0) limits.movesToGo = atoi(value);
+    }
+
+    /* A book reply needs no search; "go infinite" still waits for stop */
+    if (uci->ownBook && !limits.infinite && (best = bookPick(&uci->book, &uci->pos, &uci->bookSeed)) != MOVE_NONE) {
+        uciPrintf("info string book move\nbestmove %s\n", moveToString(best, move));
+        return;
+    }
+
+    uci->limits = limits;
+    uci->stopRequested = false;
+    statsReset();
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_STACK_SIZE);
+    uci->searching = pthread_create(&uci->searchThread, &attr, searchMain, uci) == 0;
+    pthread_attr_destroy(&attr);
+    if (!uci->searching) uciPrintf("bestmove 0000\n");
+}
+
+/**
+ * runBench - fixed-depth searches over BenchFens for a node count and
+ * nps, then the cost of one static evaluation, timed over every child
+ * of the bench positions so the figure is not one cached position, with
+ * and without the pawn cache
+ */
+static void runBench(UciState* uci, char* args) {
+    static Position children[BENCH_SIZE * MAX_MOVES];
+    int depth = (args && atoi(args) > 0) ? atoi(args) : BENCH_DEPTH;
+    SearchLimits limits = {0};
+    SearchCallback callback = uci->search.onIteration;
+    uint64_t nodes = 0;
+    int64_t elapsed, start = timeNowMs();
+    int count = 0;
+    volatile int sink = 0;
+
+    limits.depth = depth;
+    uci->search.onIteration = NULL;
+    ttClear(&uci->tt);
+    statsReset();
+    for (int i = 0; i < BENCH_SIZE; ++i) {
+        Position pos;
+        SearchInfo result;
+        MoveList list;
+        UndoInfo undo;
+
+        positionSetFen(&pos, BenchFens[i]);
+        searchRun(&uci->search, &pos, &limits, &result);
+        nodes += result.nodes;
+
+        generateLegalMoves(&pos, &list);
+        for (int j = 0; j < list.count; ++j) {
+            children[count] = pos;
+            positionMakeMove(&children[count], list.moves[j], &undo);
+            children[count++].history = NULL;
+        }
+    }
+    elapsed = timeNowMs() - start;
+    uci->search.onIteration = callback;
+    uciPrintf("info string bench depth %d nodes %llu time %lld nps %llu\n", depth, (unsigned long long)nodes,
+              (long long)elapsed, (unsigned long long)(nodes * 1000 / (uint64_t)(elapsed > 0 ? elapsed : 1)));
+    if (STATS_ENABLED) printStats(false);
+
+    /* Once without the pawn cache and once through the main thread's */
+    for (int cached = 0; cached < 2; ++cached) {
+        PawnTable* pawns = cached ? &uci->search.threads[0].pawns : NULL;
+
+        start = timeNowMs();
+        for (int round = 0; round < EVAL_BENCH_ROUNDS; ++round) {
+            for (int i = 0; i < count; ++i) {
+                sink += evaluate(&children[i], pawns);
+            }
+        }
+        elapsed = timeNowMs() - start;
+        uciPrintf("info string eval pawnhash %s positions %d calls %llu time %lld ns/eval %.1f\n",
+                  cached ? "on" : "off", count, (unsigned long long)count * EVAL_BENCH_ROUNDS, (long long)elapsed,
+                  (double)elapsed * 1e6 / ((double)count * EVAL_BENCH_ROUNDS));
+    }
+    (void)sink;
+}
+
+static void handleSetOption(UciState* uci, char* args) {
+    char* name = strstr(args, "name ");
+    char* value = strstr(args, " value ");
+
+    if (!name || !value) return;
+    name += 5;
+    *value = '\0';
+    value += 7;
+
+    if (strcasecmp(name, "Hash") == 0) {
+        if (!ttResize(&uci->tt, (size_t)strtoul(value, NULL, 10))) {
+            uciPrintf("info string could not allocate %s MB hash\n", value);
+        }
+    } else if (strcasecmp(name, "PawnHash") == 0) {
+        if (!searchSetPawnHash(&uci->search, (size_t)strtoul(value, NULL, 10))) {
+            uciPrintf("info string could not allocate %s KB pawn hash\n", value);
+        }
+    } else if (strcasecmp(name, "OwnBook") == 0) {
+        uci->ownBook = strcasecmp(value, "true") == 0;
+    } else if (strcasecmp(name, "BookFile") == 0) {
+        bookClose(&uci->book);
+        if (*value && strcmp(value, "<empty>") != 0 && !bookOpen(&uci->book, value)) {
+            uciPrintf("info string could not open book %s\n", value);
+        }
+    } else if (strcasecmp(name, "BitbaseFile") == 0) {
+        bitbaseFree();
+        if (*value && strcmp(value, "<empty>") != 0 && !bitbaseInit(value, uci->search.threadCount)) {
+            uciPrintf("info string could not load or build bitbases %s\n", value);
+        }
+    } else if (strcasecmp(name, "EvalFile") == 0) {
+        nnueFree();
+        if (*value && strcmp(value, "<empty>") != 0) {
+            if (nnueLoad(value)) {
+                uciPrintf("info string network %s loaded, %s inference\n", value, nnueSimdName(nnueGetSimd()));
+            } else {
+                uciPrintf("info string could not load network %s, using the classic evaluation\n", value);
+            }
+        }
+    } else if (strcasecmp(name, "Threads") == 0) {
+        if (!searchSetThreads(&uci->search, atoi(value))) {
+            uciPrintf("info string could not allocate %s threads\n", value);
+        }
+    } else {
+        uciPrintf("info string unknown option %s\n", name);
+    }
+}
+
+/**
+ * main - UCI protocol loop on stdin/stdout
+ *
+ * Return: Always 0 (success)
+ *         otherwise 1 (failure)
+ */
+int main(void) {
+    static UciState uci;
+    char bitbasePath[BITBASE_PATH_MAX] = "<empty>";
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+
+    chessCoreInit();
+    if (!searchInit(&uci.search, 1) || !ttResize(&uci.tt, TT_DEFAULT_MB)) {
+        fprintf(stderr, "Memory allocation for the engine failed!\n");
+        return 1;
+    }
+    if (!bitbaseDefaultPath(bitbasePath, sizeof(bitbasePath))) strcpy(bitbasePath, "<empty>");
+    if (strcmp(bitbasePath, "<empty>") == 0 || !bitbaseInit(bitbasePath, uci.search.threadCount)) {
+        fprintf(stderr, "Bitbases unavailable, searching endings out\n");
+    }
+    uci.search.tt = &uci.tt;
+    uci.search.onIteration = onIteration;
+    uci.search.userData = &uci;
+    uci.ownBook = true;
+    uci.bookSeed = (uint64_t)timeNowMs() | 1;
+    pthread_mutex_init(&uci.lock, NULL);
+    pthread_cond_init(&uci.stopped, NULL);
+    positionSetStart(&uci.root);
+    uci.pos = uci.root;
+
+    while ((length = getline(&line, &capacity, stdin)) >= 0) {
+        char* saveptr = NULL;
+        char* command;
+
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (!(command = strtok_r(line, " \t", &saveptr))) continue;
+        char* args = saveptr ? saveptr : "";
+
+        if (strcmp(command, "uci") == 0) {
+            uciPrintf("id name %s\nid author %s\n", ENGINE_NAME, ENGINE_AUTHOR);
+            uciPrintf("option name Hash type spin default %d min 1 max 1048576\n", TT_DEFAULT_MB);
+            uciPrintf("option name PawnHash type spin default %d min 0 max 1048576\n", PAWN_HASH_DEFAULT_KB);
+            uciPrintf("option name OwnBook type check default true\n");
+            uciPrintf("option name BookFile type string default <empty>\n");
+            uciPrintf("option name BitbaseFile type string default %s\n", bitbasePath);
+            uciPrintf("option name EvalFile type string default <empty>\n");
+            uciPrintf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+            uciPrintf("uciok\n");
+        } else if (strcmp(command, "isready") == 0) {
+            uciPrintf("readyok\n");
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            stopSearch(&uci);
+            ttClear(&uci.tt);
+        } else if (strcmp(command, "position") == 0) {
+            stopSearch(&uci);
+            handlePosition(&uci, args);
+        } else if (strcmp(command, "go") == 0) {
+            stopSearch(&uci);
+            handleGo(&uci, args);
+        } else if (strcmp(command, "stop") == 0 || strcmp(command, "ponderhit") == 0) {
+            /* A ponder hit plays the best move found while pondering */
+            stopSearch(&uci);
+        } else if (strcmp(command, "setoption") == 0) {
+            stopSearch(&uci);
+            handleSetOption(&uci, args);
+        } else if (strcmp(command, "bench") == 0) {
+            stopSearch(&uci);
+            runBench(&uci, args);
+        } else if (strcmp(command, "stats") == 0) {
+            /* "stats" waits for no search: the counters merge while it runs */
+            if (strcmp(args, "reset") == 0) {
+                stopSearch(&uci);
+                statsReset();
+            } else {
+                printStats(strcmp(args, "json") == 0);
+            }
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        } else {
+            uciPrintf("info string unknown command %s\n", command);
+        }
+    }
+
+    stopSearch(&uci);
+    free(line);
+    recordFree(&uci.record);
+    ttFree(&uci.tt);
+    bookClose(&uci.book);
+    bitbaseFree();
+    nnueFree();
+    searchFree(&uci.search);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "book.h"
+
+/**
+ * BookKeyCase - a position and the key the Polyglot format description
+ * gives for it
+ */
+typedef struct {
+    const char* fen;
+    uint64_t key;
+} BookKeyCase;
+
+static const BookKeyCase keyCases[] = {
+    {START_FEN, POLYGLOT_START_KEY},
+    {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+    {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0ULL},
+    {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652A607CA3F242C1ULL},
+    {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9ULL},
+    {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3C8123EA7B067637ULL},
+    {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5C3F9B829B279560ULL},
+};
+
+#define KEY_CASES ((int)(sizeof(keyCases) / sizeof(keyCases[0])))
+
+/**
+ * main - checks book keys against the published Polyglot test positions
+ *
+ * Return: 0 if every key matches, 1 otherwise
+ */
+int main(void) {
+    int failed = 0;
+
+    chessCoreInit();
+
+    if (!bookUsesPolyglotKeys()) {
+        fprintf(stderr, "start position key self-check failed\n");
+        ++failed;
+    }
+    for (int i = 0; i < KEY_CASES; ++i) {
+        Position pos;
+        uint64_t key;
+
+        if (!positionSetFen(&pos, keyCases[i].fen)) {
+            fprintf(stderr, "invalid FEN %s\n", keyCases[i].fen);
+            ++failed;
+            continue;
+        }
+        key = bookKey(&pos);
+        if (key != keyCases[i].key) {
+            fprintf(stderr, "%s: key %016llx, expected %016llx\n", keyCases[i].fen, (unsigned long long)key,
+                    (unsigned long long)keyCases[i].key);
+            ++failed;
+        }
+    }
+    printf("%d positions, %d failed\n", KEY_CASES, failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
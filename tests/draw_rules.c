@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "movegen.h"
+
+#define GAME_PLIES 16
+
+static int failed = 0;
+
+static void expect(bool condition, const char* what) {
+    if (condition) return;
+    fprintf(stderr, "failed: %s\n", what);
+    ++failed;
+}
+
+/* The legal move written as @text in coordinate notation, MOVE_NONE if none */
+static Move findMove(const Position* pos, const char* text) {
+    MoveList list;
+    char buffer[6];
+
+    generateLegalMoves(pos, &list);
+    for (int i = 0; i < list.count; ++i) {
+        if (strcmp(moveToString(list.moves[i], buffer), text) == 0) return list.moves[i];
+    }
+    return MOVE_NONE;
+}
+
+/* Plays @moves, space separated, from @pos; false at the first illegal one */
+static bool playMoves(Position* pos, const char* moves, UndoInfo* undo, int* ply) {
+    char text[6];
+    int length;
+
+    while (sscanf(moves, " %5s%n", text, &length) == 1) {
+        Move move = findMove(pos, text);
+
+        if (move == MOVE_NONE || *ply == GAME_PLIES) return false;
+        positionMakeMove(pos, move, &undo[(*ply)++]);
+        moves += length;
+    }
+    return true;
+}
+
+static void checkFiftyMoves(void) {
+    static const char* fen = "7k/6pp/8/8/8/8/8/R5K1 w - - 99 80";
+    UndoInfo undo[GAME_PLIES];
+    Position pos;
+    int ply = 0;
+
+    positionSetFen(&pos, fen);
+    expect(!positionIsDraw(&pos, 0), "ninety-nine halfmoves are not yet a draw");
+
+    expect(playMoves(&pos, "g1f1", undo, &ply), "quiet hundredth halfmove is legal");
+    expect(pos.rule50 == 100, "quiet move counts towards the fifty moves");
+    expect(positionIsDraw(&pos, 0), "hundred halfmoves without mate are a draw");
+
+    positionSetFen(&pos, fen);
+    ply = 0;
+    expect(playMoves(&pos, "a1a8", undo, &ply), "mating hundredth halfmove is legal");
+    expect(positionIsCheckMate(&pos), "Ra8 mates");
+    expect(!positionIsDraw(&pos, 0), "checkmate on the hundredth halfmove stands");
+}
+
+static void checkRepetition(void) {
+    UndoInfo undo[GAME_PLIES];
+    Position pos;
+    int ply = 0;
+
+    positionSetStart(&pos);
+    expect(playMoves(&pos, "g1f3 g8f6 f3g1 f6g8", undo, &ply), "knight shuffle is legal");
+    expect(!positionIsDraw(&pos, 0), "second occurrence is not a draw by the game rule");
+    expect(positionIsDraw(&pos, 4), "repeating a position at the search root is a draw");
+    expect(!positionIsDraw(&pos, 2), "a single repetition before the root is not a draw");
+
+    expect(playMoves(&pos, "g1f3 g8f6 f3g1 f6g8", undo, &ply), "second knight shuffle is legal");
+    expect(positionIsDraw(&pos, 0), "third occurrence is a draw by the game rule");
+    expect(positionIsDraw(&pos, 2), "twofold repetition before the root is a draw");
+
+    positionSetStart(&pos);
+    ply = 0;
+    expect(playMoves(&pos, "g1f3 g8f6 f3g1 f6g8 b1c3", undo, &ply), "shuffle then a new move is legal");
+    expect(!positionIsDraw(&pos, 5), "a new position is not a repetition");
+}
+
+/**
+ * main - checks the fifty-move rule, its checkmate exception and
+ * repetitions inside and before the search root
+ *
+ * Return: 0 if every check holds, 1 otherwise
+ */
+int main(void) {
+    chessCoreInit();
+
+    checkFiftyMoves();
+    checkRepetition();
+
+    printf("%d failed checks\n", failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "eval.h"
+#include "misc.h"
+#include "movegen.h"
+
+#define GAME_SEED 0x9E3779B97F4A7C15ULL
+#define GAMES_PER_START 16
+#define GAME_PLIES 200
+
+/* Starts that reach castling, en passant and promotions quickly */
+static const char* startFens[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+#define START_COUNT ((int)(sizeof(startFens) / sizeof(startFens[0])))
+
+/* Material and piece-square sum of @pos, from scratch */
+static Score computePsq(const Position* pos) {
+    Score psq = 0;
+
+    for (int square = 0; square < SQUARE_NB; ++square) {
+        psq += PieceSquare[pos->board[square]][square];
+    }
+    return psq;
+}
+
+/* The incrementally kept state of @pos must equal a recomputation */
+static int checkPosition(const Position* pos, const char* when) {
+    char fen[FEN_MAX];
+    Position rebuilt;
+    int failed = 0;
+
+    if (pos->psq != computePsq(pos)) {
+        fprintf(stderr, "%s: psq differs after %s\n", positionToFen(pos, fen), when);
+        ++failed;
+    }
+    if (pos->key != positionComputeKey(pos)) {
+        fprintf(stderr, "%s: key differs after %s\n", positionToFen(pos, fen), when);
+        ++failed;
+    }
+    positionSetFen(&rebuilt, positionToFen(pos, fen));
+    if (pos->pawnKey != rebuilt.pawnKey) {
+        fprintf(stderr, "%s: pawn key differs after %s\n", fen, when);
+        ++failed;
+    }
+    return failed;
+}
+
+/**
+ * main - plays random games in which every legal move is made, checked
+ * and taken back, comparing the incremental piece-square score, key and
+ * pawn key with values computed from scratch
+ *
+ * Return: 0 if they always agree, 1 otherwise
+ */
+int main(void) {
+    static UndoInfo undo[GAME_PLIES];
+    uint64_t seed = GAME_SEED, checked = 0;
+    int failed = 0;
+
+    chessCoreInit();
+
+    for (int s = 0; s < START_COUNT; ++s) {
+        for (int g = 0; g < GAMES_PER_START; ++g) {
+            Position pos;
+            MoveList list;
+
+            positionSetFen(&pos, startFens[s]);
+            failed += checkPosition(&pos, "setup");
+            for (int ply = 0; ply < GAME_PLIES; ++ply) {
+                if (generateLegalMoves(&pos, &list) == 0) break;
+
+                for (int i = 0; i < list.count; ++i) {
+                    Position before = pos;
+                    UndoInfo childUndo;
+
+                    positionMakeMove(&pos, list.moves[i], &childUndo);
+                    failed += checkPosition(&pos, "make");
+                    positionUnmakeMove(&pos, list.moves[i], &childUndo);
+                    failed += checkPosition(&pos, "unmake");
+                    if (pos.psq != before.psq || pos.key != before.key || pos.pawnKey != before.pawnKey) {
+                        fprintf(stderr, "unmake did not restore the position\n");
+                        ++failed;
+                    }
+                    checked += 2;
+                }
+                positionMakeMove(&pos, list.moves[randomNext(&seed) % (uint64_t)list.count], &undo[ply]);
+            }
+        }
+    }
+
+    printf("%llu positions checked, %d mismatches\n", (unsigned long long)checked, failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "misc.h"
+#include "movegen.h"
+#include "nnue.h"
+
+#define NETWORK_SEED 0x9E3779B97F4A7C15ULL
+#define GAMES_PER_START 8
+#define GAME_PLIES 160
+#define MAIN_LINE_STRIDE 3
+
+/* Starts that reach castling, en passant and promotions quickly */
+static const char* startFens[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+#define START_COUNT ((int)(sizeof(startFens) / sizeof(startFens[0])))
+
+static NnueAccumulator Stack[GAME_PLIES + 2];
+
+/* Score of the position from an accumulator computed from scratch */
+static int refreshed(const Position* pos) {
+    NnueAccumulator fresh;
+    Position copy = *pos;
+
+    copy.nnue = &fresh;
+    nnueReset(&fresh);
+    return nnueEvaluate(&copy);
+}
+
+static int checkPosition(const Position* pos, uint64_t* checked) {
+    char fen[FEN_MAX];
+    int incremental = nnueEvaluate(pos), expected = refreshed(pos);
+
+    ++*checked;
+    if (incremental == expected) return 0;
+    fprintf(stderr, "%s: %s incremental %d, refreshed %d\n", nnueSimdName(nnueGetSimd()), positionToFen(pos, fen),
+            incremental, expected);
+    return 1;
+}
+
+/**
+ * checkGames - random games in which every child is made, evaluated and
+ * taken back as in a search; the main line itself is evaluated only
+ * every few plies, so updates spanning several moves are covered too
+ */
+static int checkGames(uint64_t* checked) {
+    uint64_t seed = NETWORK_SEED;
+    int failed = 0;
+
+    for (int s = 0; s < START_COUNT; ++s) {
+        for (int g = 0; g < GAMES_PER_START; ++g) {
+            Position pos;
+            UndoInfo undo[GAME_PLIES];
+            MoveList list;
+
+            positionSetFen(&pos, startFens[s]);
+            pos.nnue = Stack;
+            nnueReset(Stack);
+            for (int ply = 0; ply < GAME_PLIES; ++ply) {
+                if (ply % MAIN_LINE_STRIDE == 0) failed += checkPosition(&pos, checked);
+                if (generateLegalMoves(&pos, &list) == 0) break;
+
+                for (int i = 0; i < list.count; ++i) {
+                    UndoInfo childUndo;
+
+                    positionMakeMove(&pos, list.moves[i], &childUndo);
+                    failed += checkPosition(&pos, checked);
+                    positionUnmakeMove(&pos, list.moves[i], &childUndo);
+                }
+                positionMakeMove(&pos, list.moves[randomNext(&seed) % (uint64_t)list.count], &undo[ply]);
+            }
+        }
+    }
+    return failed;
+}
+
+/**
+ * main - compares incrementally updated network scores with scores from
+ * a full refresh on every SIMD path this machine supports
+ *
+ * Return: 0 if they always agree, 1 otherwise
+ */
+int main(void) {
+    uint64_t checked = 0;
+    int failed = 0;
+
+    chessCoreInit();
+    if (!nnueRandomize(NETWORK_SEED)) {
+        fprintf(stderr, "could not allocate a network\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int simd = NNUE_SCALAR; simd < NNUE_SIMD_NB; ++simd) {
+        int before = failed;
+
+        if (!nnueSetSimd((NnueSimd)simd)) continue;
+        failed += checkGames(&checked);
+        printf("%-8s %d mismatches\n", nnueSimdName((NnueSimd)simd), failed - before);
+    }
+
+    nnueFree();
+    printf("%llu positions checked, %d mismatches\n", (unsigned long long)checked, failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "misc.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "pgn.h"
+
+#define ROUNDTRIP_SEED 0x9E3779B97F4A7C15ULL
+#define GAMES_PER_START 16
+#define GAME_PLIES 200
+#define ACCUMULATOR_UNTOUCHED 99
+
+/* Starts rich in castling, en passant, promotions and ambiguous moves */
+static const char* startFens[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "1k6/8/8/3N1N2/8/3N1N2/8/1K6 w - - 0 1",
+    "1k6/8/8/8/8/Q7/8/Q1Q3K1 w - - 0 1",
+};
+
+#define START_COUNT ((int)(sizeof(startFens) / sizeof(startFens[0])))
+
+/* Every legal move must read back from its own SAN, without touching
+ * the network accumulators of the position it is read in */
+static int checkSan(const Position* pos, const MoveList* list) {
+    char san[SAN_MAX], buffer[6], fen[FEN_MAX];
+    NnueAccumulator stack[2] = {{.dirtyCount = -1}, {.dirtyCount = ACCUMULATOR_UNTOUCHED}};
+    Position probe = *pos;
+    int failed = 0;
+
+    probe.nnue = stack;
+    for (int i = 0; i < list->count; ++i) {
+        Move move = moveFromSan(&probe, moveToSan(&probe, list->moves[i], san));
+
+        if (move != list->moves[i]) {
+            fprintf(stderr, "%s: %s (%s) reads back as %s\n", positionToFen(pos, fen), san,
+                    moveToString(list->moves[i], buffer), move == MOVE_NONE ? "nothing" : "another move");
+            ++failed;
+        }
+    }
+    if (probe.nnue != stack || stack[1].dirtyCount != ACCUMULATOR_UNTOUCHED) {
+        fprintf(stderr, "%s: SAN wrote to the caller's accumulators\n", positionToFen(pos, fen));
+        ++failed;
+    }
+    return failed;
+}
+
+/* Writes the game out, reads it back and compares the two */
+static int checkPgn(const PgnGame* game, const Position* end) {
+    FILE* file = tmpfile();
+    PgnReader reader;
+    PgnGame copy;
+    int failed = 0;
+
+    if (!file || !pgnReaderOpen(&reader, file)) {
+        perror("tmpfile");
+        if (file) fclose(file);
+        return 1;
+    }
+    pgnWrite(file, game);
+    rewind(file);
+    pgnGameInit(&copy);
+
+    if (!pgnRead(&reader, &copy)) {
+        fprintf(stderr, "game written but not read back\n");
+        failed = 1;
+    } else if (copy.error[0]) {
+        fprintf(stderr, "game read back with an error: %s\n", copy.error);
+        failed = 1;
+    } else if (copy.moveCount != game->moveCount ||
+               memcmp(copy.moves, game->moves, (size_t)game->moveCount * sizeof(Move)) != 0 ||
+               copy.start.key != game->start.key || copy.end.key != end->key ||
+               strcmp(copy.result, game->result) != 0) {
+        fprintf(stderr, "game of %d plies read back as a different game of %d plies\n", game->moveCount,
+                copy.moveCount);
+        failed = 1;
+    }
+
+    pgnGameFree(&copy);
+    pgnReaderClose(&reader);
+    fclose(file);
+    return failed;
+}
+
+/**
+ * main - plays random games from a few rich positions, checking that
+ * every legal move survives SAN and that every game survives PGN
+ *
+ * Return: 0 if everything reads back unchanged, 1 otherwise
+ */
+int main(void) {
+    static UndoInfo undo[GAME_PLIES];
+    uint64_t seed = ROUNDTRIP_SEED;
+    int games = 0, failed = 0;
+    PgnGame game;
+
+    chessCoreInit();
+    pgnGameInit(&game);
+
+    for (int s = 0; s < START_COUNT; ++s) {
+        for (int g = 0; g < GAMES_PER_START; ++g) {
+            Position pos;
+            MoveList list;
+
+            if (!positionSetFen(&pos, startFens[s])) {
+                fprintf(stderr, "invalid FEN %s\n", startFens[s]);
+                return EXIT_FAILURE;
+            }
+            pgnGameReset(&game, &pos);
+            pgnSetTag(&game, "Event", "round trip");
+
+            for (int ply = 0; ply < GAME_PLIES; ++ply) {
+                Move move;
+
+                if (generateLegalMoves(&pos, &list) == 0) {
+                    strcpy(game.result, positionIsCheckMate(&pos) ? (pos.sideToMove == WHITE ? "0-1" : "1-0")
+                                                                  : "1/2-1/2");
+                    break;
+                }
+                failed += checkSan(&pos, &list);
+                move = list.moves[randomNext(&seed) % (uint64_t)list.count];
+                if (!pgnGameAddMove(&game, move)) {
+                    fprintf(stderr, "out of memory\n");
+                    return EXIT_FAILURE;
+                }
+                positionMakeMove(&pos, move, &undo[ply]);
+            }
+            failed += checkPgn(&game, &pos);
+            ++games;
+        }
+    }
+
+    pgnGameFree(&game);
+    printf("%d games, %d failed checks\n", games, failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}